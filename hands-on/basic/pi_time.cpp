@@ -1,9 +1,12 @@
 #include <cassert>
 #include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <utility>
 
+#include "../common/bench_report.h"
+
 using Duration = std::chrono::duration<float>;
 
 std::pair<double, Duration> pi(int n)
@@ -32,4 +35,10 @@ int main(int argc, char* argv[])
 
   std::cout << "pi = " << value << " for " << n << " iterations"
             << " in " << time.count() << " s\n";
+
+  // append the time to the file given by BENCH_OUTPUT, if any
+  double const seconds = time.count();
+  char parameters[32];
+  std::snprintf(parameters, sizeof parameters, "iterations=%d", n);
+  bench_emit("pi_time", parameters, "s", bench_statistics(&seconds, 1), 1);
 }
@@ -0,0 +1,269 @@
+#ifndef bench_report_h
+#define bench_report_h
+
+/*
+ * Machine-readable benchmark results.
+ *
+ * When BENCH_OUTPUT is set to a file name, every call to bench_emit() appends a record to it, with the name of the
+ * benchmark, its parameters, the statistics of the measured times, the number of threads, and a description of the
+ * environment: host name, CPU model, frequency governor, compiler and compiler flags. The records are written as JSON,
+ * one object per line, or as CSV if the file name ends in ".csv" or BENCH_FORMAT is "csv". Without BENCH_OUTPUT
+ * nothing is written, and the benchmarks only print their usual output.
+ *
+ * The compiler flags are not known to the program itself: the Makefiles pass them in the BENCH_COMPILER_FLAGS macro.
+ *
+ * This header can be used both from C and from C++.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_COMPILER_FLAGS
+#define BENCH_COMPILER_FLAGS "unknown"
+#endif
+
+#if defined(__clang__)
+#define BENCH_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#define BENCH_COMPILER "gcc " __VERSION__
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+/* statistics of the times of repeated runs of a benchmark */
+typedef struct {
+  int repeats;
+  double min;
+  double median;
+  double mean;
+  double max;
+  double stddev;
+} bench_stats;
+
+static inline int bench_compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* compute the statistics of n measured times */
+static inline bench_stats bench_statistics(const double* times, int n) {
+  bench_stats stats = {n, 0., 0., 0., 0., 0.};
+  double* sorted;
+  double sum = 0., variance = 0.;
+  int i;
+  if (n <= 0) {
+    return stats;
+  }
+  sorted = (double*)malloc(n * sizeof(double));
+  memcpy(sorted, times, n * sizeof(double));
+  qsort(sorted, n, sizeof(double), bench_compare_doubles);
+  for (i = 0; i < n; ++i) {
+    sum += sorted[i];
+  }
+  stats.min = sorted[0];
+  stats.max = sorted[n - 1];
+  stats.median = (n % 2 == 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.;
+  stats.mean = sum / n;
+  for (i = 0; i < n; ++i) {
+    variance += (sorted[i] - stats.mean) * (sorted[i] - stats.mean);
+  }
+  stats.stddev = (n > 1) ? sqrt(variance / (n - 1)) : 0.;
+  free(sorted);
+  return stats;
+}
+
+/* statistics of a benchmark that only keeps the minimum, maximum and average time */
+static inline bench_stats bench_summary(int repeats, double min, double mean, double max) {
+  bench_stats stats = {repeats, min, NAN, mean, max, NAN};
+  return stats;
+}
+
+/* read the first line of a file, or the value of the first line that starts with key followed by ':' */
+static inline void bench_read_line(const char* path, const char* key, char* buffer, size_t size) {
+  char line[512];
+  FILE* file = fopen(path, "r");
+  snprintf(buffer, size, "unknown");
+  if (file == NULL) {
+    return;
+  }
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char* value = line;
+    size_t length;
+    if (key != NULL) {
+      if (strncmp(line, key, strlen(key)) != 0 || (value = strchr(line, ':')) == NULL) {
+        continue;
+      }
+      value += 1 + strspn(value + 1, " \t");
+    }
+    /* copy the value without the newline, truncated to the size of the buffer */
+    length = strcspn(value, "\n");
+    if (length >= size) {
+      length = size - 1;
+    }
+    memcpy(buffer, value, length);
+    buffer[length] = '\0';
+    break;
+  }
+  fclose(file);
+}
+
+/* write a string as a JSON string, escaping the special characters */
+static inline void bench_json_string(FILE* out, const char* s) {
+  fputc('"', out);
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(out, "\\%c", *s);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(out, "\\u%04x", (unsigned char)*s);
+    } else {
+      fputc(*s, out);
+    }
+  }
+  fputc('"', out);
+}
+
+/* write a string as a CSV field, quoting it */
+static inline void bench_csv_string(FILE* out, const char* s) {
+  fputc('"', out);
+  for (; *s != '\0'; ++s) {
+    if (*s == '"') {
+      fputc('"', out);
+    }
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+/* write a number, or null if it is not available */
+static inline void bench_number(FILE* out, double value, const char* null) {
+  if (isnan(value)) {
+    fputs(null, out);
+  } else {
+    fprintf(out, "%.9g", value);
+  }
+}
+
+/*
+ * Append a record with the results of a benchmark to the file given by BENCH_OUTPUT, if any.
+ * The parameters are a comma-separated list of key=value pairs, e.g. "size=1000000,policy=par"; they are written as a
+ * JSON object, or as a single field in CSV. The unit is the unit of the times, e.g. "ms" or "s".
+ */
+static inline void bench_emit(const char* benchmark, const char* parameters, const char* unit, bench_stats stats,
+                              int threads) {
+  const char* path = getenv("BENCH_OUTPUT");
+  const char* format = getenv("BENCH_FORMAT");
+  const char* extension;
+  char host[256], cpu[256], governor[64], timestamp[32], parameter[256];
+  const char* p;
+  time_t now = time(NULL);
+  FILE* out;
+  int csv;
+
+  if (path == NULL || strlen(path) == 0) {
+    return;
+  }
+  extension = strrchr(path, '.');
+  csv = (format != NULL && strcmp(format, "csv") == 0) ||
+        (format == NULL && extension != NULL && strcmp(extension, ".csv") == 0);
+
+  out = fopen(path, "a");
+  if (out == NULL) {
+    fprintf(stderr, "Cannot open %s for writing\n", path);
+    return;
+  }
+
+  bench_read_line("/proc/sys/kernel/hostname", NULL, host, sizeof(host));
+  bench_read_line("/proc/cpuinfo", "model name", cpu, sizeof(cpu));
+  bench_read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", NULL, governor, sizeof(governor));
+  strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  if (parameters == NULL) {
+    parameters = "";
+  }
+
+  if (csv) {
+    /* write the header only at the beginning of a new file */
+    fseek(out, 0, SEEK_END);
+    if (ftell(out) == 0) {
+      fputs("timestamp,benchmark,parameters,threads,repeats,unit,min,median,mean,max,stddev,"
+            "host,cpu,governor,compiler,flags\n",
+            out);
+    }
+    fprintf(out, "%s,", timestamp);
+    bench_csv_string(out, benchmark);
+    fputc(',', out);
+    bench_csv_string(out, parameters);
+    fprintf(out, ",%d,%d,%s,", threads, stats.repeats, unit);
+    bench_number(out, stats.min, "");
+    fputc(',', out);
+    bench_number(out, stats.median, "");
+    fputc(',', out);
+    bench_number(out, stats.mean, "");
+    fputc(',', out);
+    bench_number(out, stats.max, "");
+    fputc(',', out);
+    bench_number(out, stats.stddev, "");
+    fputc(',', out);
+    bench_csv_string(out, host);
+    fputc(',', out);
+    bench_csv_string(out, cpu);
+    fputc(',', out);
+    bench_csv_string(out, governor);
+    fputc(',', out);
+    bench_csv_string(out, BENCH_COMPILER);
+    fputc(',', out);
+    bench_csv_string(out, BENCH_COMPILER_FLAGS);
+    fputc('\n', out);
+  } else {
+    fprintf(out, "{\"timestamp\": \"%s\", \"benchmark\": ", timestamp);
+    bench_json_string(out, benchmark);
+    fputs(", \"parameters\": {", out);
+    /* split the parameters in key=value pairs */
+    for (p = parameters; *p != '\0';) {
+      size_t length = strcspn(p, ",");
+      char* value;
+      snprintf(parameter, sizeof(parameter), "%.*s", (int)length, p);
+      value = strchr(parameter, '=');
+      if (value != NULL) {
+        *value++ = '\0';
+      }
+      if (p != parameters) {
+        fputs(", ", out);
+      }
+      bench_json_string(out, parameter);
+      fputs(": ", out);
+      bench_json_string(out, value != NULL ? value : "");
+      p += length;
+      if (*p == ',') {
+        ++p;
+      }
+    }
+    fprintf(out, "}, \"threads\": %d, \"repeats\": %d, \"unit\": \"%s\", \"min\": ", threads, stats.repeats, unit);
+    bench_number(out, stats.min, "null");
+    fputs(", \"median\": ", out);
+    bench_number(out, stats.median, "null");
+    fputs(", \"mean\": ", out);
+    bench_number(out, stats.mean, "null");
+    fputs(", \"max\": ", out);
+    bench_number(out, stats.max, "null");
+    fputs(", \"stddev\": ", out);
+    bench_number(out, stats.stddev, "null");
+    fputs(", \"host\": ", out);
+    bench_json_string(out, host);
+    fputs(", \"cpu\": ", out);
+    bench_json_string(out, cpu);
+    fputs(", \"governor\": ", out);
+    bench_json_string(out, governor);
+    fputs(", \"compiler\": ", out);
+    bench_json_string(out, BENCH_COMPILER);
+    fputs(", \"flags\": ", out);
+    bench_json_string(out, BENCH_COMPILER_FLAGS);
+    fputs("}\n", out);
+  }
+  fclose(out);
+}
+
+#endif /* bench_report_h */
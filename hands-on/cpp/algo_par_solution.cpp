@@ -0,0 +1,187 @@
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <execution>
+#include <functional>
+#include <chrono>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tbb/tbb.h>
+
+using Clock = std::chrono::steady_clock;
+using Duration = std::chrono::duration<float>;
+
+// sum of the elements in [first, last) with several independent accumulators:
+// consecutive additions do not depend on each other, so the loop can be
+// vectorised, and the additions of different lanes can be pipelined
+template <typename Acc>
+Acc multi_accumulator_sum(int const* first, int const* last)
+{
+  constexpr std::size_t lanes = 16;
+  Acc partial[lanes] = {};
+  std::size_t const n = last - first;
+  std::size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    for (std::size_t j = 0; j != lanes; ++j) {
+      partial[j] += first[i + j];
+    }
+  }
+  for (; i != n; ++i) {
+    partial[0] += first[i];
+  }
+  return std::accumulate(std::begin(partial), std::end(partial), Acc{0});
+}
+
+// run a reduction a few times, and print its best time and its result
+template <typename Acc, typename Reduce>
+void benchmark(std::string const& name, std::vector<int> const& v, std::int64_t expected, Reduce reduce)
+{
+  int const REPEATS = 5;
+  Acc sum{};
+  Duration best = Duration::max();
+  for (int i = 0; i != REPEATS; ++i) {
+    auto t0 = Clock::now();
+    sum = reduce();
+    auto t1 = Clock::now();
+    best = std::min<Duration>(best, t1 - t0);
+  }
+  float const gbs = v.size() * sizeof(int) / best.count() / 1.e9f;
+  std::cout << name << ": sum = " << sum << " in " << best.count() << " s, "
+            << gbs << " GB/s\n";
+  assert(sum == expected);
+}
+
+// sum all the elements of the vector with the different algorithms, using
+// accumulators of type Acc
+template <typename Acc>
+void reductions(std::vector<int> const& v, std::int64_t expected)
+{
+  auto const first = v.begin();
+  auto const last = v.end();
+
+  benchmark<Acc>("std::accumulate", v, expected, [&] {
+    return std::accumulate(first, last, Acc{0});
+  });
+  benchmark<Acc>("std::reduce, seq", v, expected, [&] {
+    return std::reduce(std::execution::seq, first, last, Acc{0});
+  });
+  benchmark<Acc>("std::reduce, par", v, expected, [&] {
+    return std::reduce(std::execution::par, first, last, Acc{0});
+  });
+  benchmark<Acc>("std::reduce, par_unseq", v, expected, [&] {
+    return std::reduce(std::execution::par_unseq, first, last, Acc{0});
+  });
+  // the transformation widens each element to the type of the accumulator
+  benchmark<Acc>("std::transform_reduce, par_unseq", v, expected, [&] {
+    return std::transform_reduce(std::execution::par_unseq, first, last, Acc{0}, std::plus<Acc>(),
+                                 [](int x) { return static_cast<Acc>(x); });
+  });
+  benchmark<Acc>("tbb::parallel_reduce", v, expected, [&] {
+    return tbb::parallel_reduce(
+        tbb::blocked_range<std::size_t>(0, v.size()), Acc{0},
+        [&](tbb::blocked_range<std::size_t> const& range, Acc sum) {
+          for (std::size_t i = range.begin(); i != range.end(); ++i) {
+            sum += v[i];
+          }
+          return sum;
+        },
+        std::plus<Acc>());
+  });
+  benchmark<Acc>("multi-accumulator", v, expected, [&] {
+    return multi_accumulator_sum<Acc>(v.data(), v.data() + v.size());
+  });
+  benchmark<Acc>("multi-accumulator, tbb::parallel_reduce", v, expected, [&] {
+    return tbb::parallel_reduce(
+        tbb::blocked_range<std::size_t>(0, v.size()), Acc{0},
+        [&](tbb::blocked_range<std::size_t> const& range, Acc sum) {
+          return sum + multi_accumulator_sum<Acc>(v.data() + range.begin(), v.data() + range.end());
+        },
+        std::plus<Acc>());
+  });
+}
+
+int main()
+{
+  // define a pseudo-random number generator engine and seed it using an actual
+  // random device
+  std::random_device rd;
+  std::default_random_engine eng{rd()};
+
+  // the largest value of the elements can be changed with REDUCE_MAX_VALUE
+  int MAX_N = 100;
+  const char* max_env = std::getenv("REDUCE_MAX_VALUE");
+  if (max_env != nullptr and std::strlen(max_env) != 0) {
+    MAX_N = std::max(1, std::atoi(max_env));
+  }
+  std::uniform_int_distribution<int> uniform_dist{1, MAX_N};
+
+  // fill a vector with SIZE random numbers
+  int const SIZE = 10'000'000;
+  std::vector<int> v;
+  v.reserve(SIZE);
+  std::generate_n(std::back_inserter(v), SIZE, [&] { return uniform_dist(eng); });
+
+  // the sums use 64-bit accumulators, unless REDUCE_ACCUMULATOR=32; 10M
+  // elements of value up to 100 add up to at most 10^9, close to the limit of a
+  // 32-bit int
+  int bits = 64;
+  const char* accumulator_env = std::getenv("REDUCE_ACCUMULATOR");
+  if (accumulator_env != nullptr and std::strlen(accumulator_env) != 0) {
+    bits = std::atoi(accumulator_env);
+  }
+
+  std::int64_t const expected = std::accumulate(v.begin(), v.end(), std::int64_t{0});
+  if (bits == 32) {
+    // a signed overflow is undefined behaviour, so check before summing
+    if (expected > std::numeric_limits<std::int32_t>::max()) {
+      std::cerr << "the sum " << expected << " overflows a 32-bit accumulator, use REDUCE_ACCUMULATOR=64\n";
+      return EXIT_FAILURE;
+    }
+    std::cout << "32-bit accumulators\n";
+    reductions<std::int32_t>(v, expected);
+  } else {
+    std::cout << "64-bit accumulators\n";
+    reductions<std::int64_t>(v, expected);
+  }
+  std::cout << '\n';
+
+  {
+    auto copy = v;
+    auto t0 = Clock::now();
+    // sort the vector with std::sort
+    std::sort(copy.begin(), copy.end());
+    auto t1 = Clock::now();
+    Duration d = t1 - t0;
+    std::cout << "std::sort in " << d.count() << " s\n";
+    assert(std::is_sorted(copy.begin(), copy.end()));
+  }
+
+  {
+    auto copy = v;
+    auto t0 = Clock::now();
+    // sort the vector with std::sort, sequential policy
+    std::sort(std::execution::seq, copy.begin(), copy.end());
+    auto t1 = Clock::now();
+    Duration d = t1 - t0;
+    std::cout << "std::sort, seq in " << d.count() << " s\n";
+    assert(std::is_sorted(copy.begin(), copy.end()));
+  }
+
+  {
+    auto copy = v;
+    auto t0 = Clock::now();
+    // sort the vector with std::sort, parallel policy
+    std::sort(std::execution::par, copy.begin(), copy.end());
+    auto t1 = Clock::now();
+    Duration d = t1 - t0;
+    std::cout << "std::sort, par in " << d.count() << " s\n";
+    assert(std::is_sorted(copy.begin(), copy.end()));
+  }
+}
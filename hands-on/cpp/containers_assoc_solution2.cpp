@@ -6,8 +6,11 @@
 #include <iostream>
 #include <random>
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
 
+#include "../common/bench_report.h"
+
 using Clock = std::chrono::steady_clock;
 using Duration = std::chrono::duration<float>;
 
@@ -77,20 +80,31 @@ Duration process(Container const& cont)
   return Clock::now() - start;
 }
 
+// print the time of an operation on a container, and append it to the file
+// given by BENCH_OUTPUT, if any
+void report(char const* container, char const* operation, int N, Duration time)
+{
+  std::cout << container << ' ' << operation << ": " << time.count() << " s\n";
+  double const seconds = time.count();
+  char parameters[96];
+  std::snprintf(parameters, sizeof parameters, "container=%s,operation=%s,N=%d", container, operation, N);
+  bench_emit("containers_assoc", parameters, "s", bench_statistics(&seconds, 1), 1);
+}
+
 int main(int argc, char* argv[])
 {
   int const N = (argc > 1) ? std::atoi(argv[1]) : 10000;
 
   std::vector<int> v;
-  std::cout << "vector fill: " << fill(v, N).count() << " s\n";
-  std::cout << "vector process: " << process(v).count() << " s\n";
+  report("vector", "fill", N, fill(v, N));
+  report("vector", "process", N, process(v));
   std::list<int> l;
-  std::cout << "list fill: " << fill(l, N).count() << " s\n";
-  std::cout << "list process: " << process(l).count() << " s\n";
+  report("list", "fill", N, fill(l, N));
+  report("list", "process", N, process(l));
   std::set<int> s;
-  std::cout << "set fill: " << fill(s, N).count() << " s\n";
-  std::cout << "set process: " << process(s).count() << " s\n";
+  report("set", "fill", N, fill(s, N));
+  report("set", "process", N, process(s));
   std::unordered_set<int> u;
-  std::cout << "unordered set fill: " << fill(u, N).count() << " s\n";
-  std::cout << "unordered set process: " << process(u).count() << " s\n";
+  report("unordered set", "fill", N, fill(u, N));
+  report("unordered set", "process", N, process(u));
 }
@@ -4,8 +4,11 @@
 #include <iostream>
 #include <random>
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
 
+#include "../common/bench_report.h"
+
 using Clock = std::chrono::steady_clock;
 using Duration = std::chrono::duration<float>;
 
@@ -48,14 +51,25 @@ Duration process(Container const& cont)
   return Clock::now() - start;
 }
 
+// print the time of an operation on a container, and append it to the file
+// given by BENCH_OUTPUT, if any
+void report(char const* container, char const* operation, int N, Duration time)
+{
+  std::cout << container << ' ' << operation << ": " << time.count() << " s\n";
+  double const seconds = time.count();
+  char parameters[96];
+  std::snprintf(parameters, sizeof parameters, "container=%s,operation=%s,N=%d", container, operation, N);
+  bench_emit("containers", parameters, "s", bench_statistics(&seconds, 1), 1);
+}
+
 int main(int argc, char* argv[])
 {
   int const N = (argc > 1) ? std::atoi(argv[1]) : 10000;
 
   std::vector<int> v;
-  std::cout << "vector fill: " << fill(v, N).count() << " s\n";
-  std::cout << "vector process: " << process(v).count() << " s\n";
+  report("vector", "fill", N, fill(v, N));
+  report("vector", "process", N, process(v));
   std::list<int> l;
-  std::cout << "list fill: " << fill(l, N).count() << " s\n";
-  std::cout << "list process: " << process(l).count() << " s\n";
+  report("list", "fill", N, fill(l, N));
+  report("list", "process", N, process(l));
 }
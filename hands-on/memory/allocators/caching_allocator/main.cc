@@ -1,6 +1,7 @@
 #include "CachingAllocator.h"
 #include "ParticleSoA.h"
 #include "ParticleSoAVec.h"
+#include "../../../common/bench_report.h"
 #include <chrono>
 #include <random>
 #include <stdlib.h>
@@ -67,7 +68,8 @@ int main() {
 
   allocator.free();
 
-  std::cout << "Elapsed time Caching Allocator: " << timer.elapsed() << " ms "
+  const double cachingTime = timer.elapsed();
+  std::cout << "Elapsed time Caching Allocator: " << cachingTime << " ms "
             << std::endl;
 
   timer.reset();
@@ -95,8 +97,20 @@ int main() {
     }
   }
 
-  std::cout << "Elapsed time Without Caching Allocator: " << timer.elapsed()
+  const double vectorTime = timer.elapsed();
+  std::cout << "Elapsed time Without Caching Allocator: " << vectorTime
             << " ms " << std::endl;
 
+  // Append both times to the file given by BENCH_OUTPUT, if any
+  char parameters[64];
+  snprintf(parameters, sizeof(parameters), "allocator=caching,iterations=%d",
+           NIter);
+  bench_emit("caching_allocator", parameters, "ms",
+             bench_statistics(&cachingTime, 1), 1);
+  snprintf(parameters, sizeof(parameters),
+           "allocator=std::vector,iterations=%d", NIter);
+  bench_emit("caching_allocator", parameters, "ms",
+             bench_statistics(&vectorTime, 1), 1);
+
   return 0;
 }
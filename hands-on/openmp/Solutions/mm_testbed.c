@@ -73,18 +73,19 @@ int main(int argc, char **argv)
 
    printf("\n==================================================\n");
    printf(" triple loop, ijk case %d %d %d\n", Ndim, Mdim, Pdim);
-   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ijk);
+   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ijk, "ijk", 1);
 
    printf("\n==================================================\n");
    printf(" triple loop, ikj case %d %d %d\n", Ndim, Mdim, Pdim);
-   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ikj);
+   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ikj, "ikj", 1);
 
    printf("\n==================================================\n");
    printf(" triple loop, ikj par case %d %d %d\n", Ndim, Mdim, Pdim);
-   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ikj_par);
+   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ikj_par,
+                "ikj_par", omp_get_max_threads());
 
    printf("\n==================================================\n");
    printf(" transpose B case %d %d %d\n", Ndim, Mdim, Pdim);
-   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_trans);
+   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_trans, "trans", 1);
 
 }
@@ -12,7 +12,8 @@
 
 void mm_tst_cases(int NTRIALS, int Ndim, int Mdim, int Pdim, 
               TYPE* A, TYPE* B, TYPE* C, 
-              void (*mm_func)(int, int, int, TYPE *, TYPE *, TYPE *))
+              void (*mm_func)(int, int, int, TYPE *, TYPE *, TYPE *),
+              const char* kernel, int nthreads)
 {
    int    nerr, itrials;
    double err,  errsq, mflops;
@@ -45,7 +46,8 @@ void mm_tst_cases(int NTRIALS, int Ndim, int Mdim, int Pdim,
    }
 
    ave_t = ave_t/(double)NTRIALS;
-   output_results(Ndim, Mdim, Pdim, nerr, ave_t, min_t, max_t);
+   output_results(kernel, "constant", nthreads,
+                  Ndim, Mdim, Pdim, NTRIALS, nerr, ave_t, min_t, max_t);
 
    init_progression_matrix (Ndim, Mdim, Pdim, A, B, Cref);
 
@@ -83,5 +85,6 @@ void mm_tst_cases(int NTRIALS, int Ndim, int Mdim, int Pdim,
    }
 
    ave_t = ave_t/(double)NTRIALS;
-   output_results(Ndim, Mdim, Pdim, nerr, ave_t, min_t, max_t);
+   output_results(kernel, "progression", nthreads,
+                  Ndim, Mdim, Pdim, NTRIALS, nerr, ave_t, min_t, max_t);
 }
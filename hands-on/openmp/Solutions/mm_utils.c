@@ -3,6 +3,7 @@
 // generators for my matrix multiplication test bed.
 //
 #include "mm_utils.h"
+#include "bench_report.h"
 
 //
 // Compare two matrices ... return the sum of the squares 
@@ -46,12 +47,15 @@ void mm_print(int Ndim, int Mdim, TYPE *C){
 
 
 //
-//  Print error and timing results to standard out.
+//  Print error and timing results to standard out, and record them
+//  for the given kernel, test matrices and number of threads.
 //
-void output_results(int Ndim, int Mdim, int Pdim, 
+void output_results(const char* kernel, const char* matrices, int nthreads,
+            int Ndim, int Mdim, int Pdim, int ntrials,
             int nerr, double ave_t, double min_t, double max_t){
 
    double dN, min_flop, max_flop, ave_flop;
+   char parameters[256];
 
    if(nerr>0)printf(" %d errors\n",nerr);
    printf(" mult: ave=%f, min=%f, max=%f secs \n",
@@ -60,6 +64,12 @@ void output_results(int Ndim, int Mdim, int Pdim,
    ave_flop = dN/ave_t; max_flop = dN/min_t; min_flop = dN/max_t;
    printf(" mult: ave=%f, min=%f, max=%f Mflops \n",
                  ave_flop, min_flop, max_flop);
+
+   snprintf(parameters, sizeof(parameters),
+                 "kernel=%s,matrices=%s,N=%d,M=%d,P=%d,errors=%d",
+                 kernel, matrices, Ndim, Mdim, Pdim, nerr);
+   bench_emit("mm_testbed", parameters, "s",
+                 bench_summary(ntrials, min_t, ave_t, max_t), nthreads);
 }
 
 //=========================================================
@@ -29,6 +29,7 @@ History: Written by Tim Mattson, 11/99.
 */
 #include <stdio.h>
 #include <omp.h>
+#include "bench_report.h"
 static long num_steps = 100000000;
 double step;
 int main ()
@@ -36,6 +37,7 @@ int main ()
 	  int i;
 	  double x, pi, sum = 0.0;
 	  double start_time, run_time;
+	  char parameters[64];
 
 	  step = 1.0/(double) num_steps;
 	 for (i=1;i<=4;i++){
@@ -56,6 +58,9 @@ int main ()
 	  pi = step * sum;
 	  run_time = omp_get_wtime() - start_time;
 	  printf("\n pi is %f in %f seconds and %d threads\n",pi,run_time,i);
+
+	  snprintf(parameters, sizeof(parameters), "variant=loop,steps=%ld", num_steps);
+	  bench_emit("pi", parameters, "s", bench_statistics(&run_time, 1), i);
 }
 }	  
 
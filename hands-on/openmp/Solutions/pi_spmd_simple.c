@@ -38,6 +38,7 @@ History: Written by Tim Mattson, 11/99.
 
 #include <stdio.h>
 #include <omp.h>
+#include "bench_report.h"
 
 #define MAX_THREADS 4
 
@@ -49,6 +50,7 @@ int main ()
 	  double pi, full_sum = 0.0;
 	  double start_time, run_time;
 	  double sum[MAX_THREADS];
+	  char parameters[64];
 
 	  step = 1.0/(double) num_steps;
 
@@ -83,6 +85,9 @@ int main ()
       pi = step * full_sum;
       run_time = omp_get_wtime() - start_time;
       printf("\n pi is %f in %f seconds %d thrds \n",pi,run_time,j);
+
+      snprintf(parameters, sizeof(parameters), "variant=spmd_simple,steps=%ld", num_steps);
+      bench_emit("pi", parameters, "s", bench_statistics(&run_time, 1), j);
    }
 }	  
 
@@ -15,6 +15,7 @@ History: Written by Tim Mattson, 10/2013
 */
 #include <omp.h>
 #include <stdio.h>
+#include "bench_report.h"
 static long num_steps = 1024*1024*1024;
 #define MIN_BLK  1024*1024*256
 #define MAX 4
@@ -43,6 +44,7 @@ double pi_comp(int Nstart,int Nfinish,double step)
    int i,j;
    double step, pi, sum;
    double init_time, final_time;
+   char parameters[64];
    step = 1.0/(double) num_steps;
    for (j=1; j<=MAX; j++){
       omp_set_num_threads(j);
@@ -58,5 +60,8 @@ double pi_comp(int Nstart,int Nfinish,double step)
        pi = step * sum;
        final_time = omp_get_wtime() - init_time;
        printf(" for %ld steps pi = %f in %f secs\n",num_steps,pi,final_time);
+
+       snprintf(parameters, sizeof(parameters), "variant=task,steps=%ld", num_steps);
+       bench_emit("pi", parameters, "s", bench_statistics(&final_time, 1), j);
    }
  }  
@@ -68,6 +68,6 @@ int main(int argc, char **argv)
 
    printf("\n==================================================\n");
    printf(" triple loop, ijk case %d %d %d\n", Ndim, Mdim, Pdim);
-   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ijk);
+   mm_tst_cases(NTRIALS, Ndim, Mdim, Pdim, A, B, C, &mm_ijk, "ijk", 1);
 
 }
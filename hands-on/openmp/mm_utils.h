@@ -21,11 +21,13 @@ void init_const_matrix (int Ndim,  int Mdim,  int Pdim,
 void init_progression_matrix (int Ndim,  int Mdim,  int Pdim, 
                   TYPE *A, TYPE* B, TYPE* C);
  
-void output_results(int Ndim, int Mdim, int Pdim, 
+void output_results(const char* kernel, const char* matrices, int nthreads,
+                  int Ndim, int Mdim, int Pdim, int ntrials,
                   int nerr, double ave_t, double min_t, double max_t);
 
 void mm_tst_cases(int NTRIALS, int Ndim, int Mdim, int Pdim, TYPE* A, TYPE* B, TYPE* C, 
-              void (*mm_func)(int, int, int, TYPE *, TYPE *, TYPE *));
+              void (*mm_func)(int, int, int, TYPE *, TYPE *, TYPE *),
+              const char* kernel, int nthreads);
 
 void init_diag_dom_matrix(int Ndim,  TYPE *A);
 
@@ -0,0 +1,136 @@
+#ifndef distributions_h
+#define distributions_h
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "philox.h"
+
+// Input distributions for the sort benchmarks.
+//
+// Real data is rarely uniformly random: it is often already sorted or almost sorted, has many repeated values, or
+// follows a skewed distribution. Each of these cases favours different algorithms, e.g. adaptive comparison sorts on
+// presorted data, or radix sorts on random keys.
+
+enum class Distribution { uniform, sorted, reverse, nearly_sorted, few_unique, zipf, organ_pipe };
+
+inline constexpr std::array<Distribution, 7> all_distributions = {Distribution::uniform,
+                                                                  Distribution::sorted,
+                                                                  Distribution::reverse,
+                                                                  Distribution::nearly_sorted,
+                                                                  Distribution::few_unique,
+                                                                  Distribution::zipf,
+                                                                  Distribution::organ_pipe};
+
+inline std::string_view name(Distribution distribution) {
+  switch (distribution) {
+    case Distribution::uniform:
+      return "uniform";
+    case Distribution::sorted:
+      return "sorted";
+    case Distribution::reverse:
+      return "reverse";
+    case Distribution::nearly_sorted:
+      return "nearly_sorted";
+    case Distribution::few_unique:
+      return "few_unique";
+    case Distribution::zipf:
+      return "zipf";
+    case Distribution::organ_pipe:
+      return "organ_pipe";
+  }
+  return "unknown";
+}
+
+// bijective mixing of a 64-bit value (the splitmix64 finaliser), used to turn small integers into random-looking keys
+inline std::uint64_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+// generate size keys with the given distribution; the random keys are generated and sorted in parallel, while gen only
+// provides the seeds
+inline std::vector<std::uint64_t> generate(Distribution distribution, size_t size, std::mt19937_64& gen) {
+  std::vector<std::uint64_t> v(size);
+  switch (distribution) {
+    case Distribution::uniform:
+      philox::fill_bits(v, gen());
+      break;
+
+    case Distribution::sorted:
+      philox::fill_bits(v, gen());
+      tbb::parallel_sort(v);
+      break;
+
+    case Distribution::reverse:
+      philox::fill_bits(v, gen());
+      tbb::parallel_sort(v, std::greater<>());
+      break;
+
+    case Distribution::nearly_sorted: {
+      // sorted, with 1% of the keys swapped with a random other key
+      philox::fill_bits(v, gen());
+      tbb::parallel_sort(v);
+      std::uniform_int_distribution<size_t> index(0, size - 1);
+      for (size_t i = 0; i < size / 100; ++i) {
+        std::swap(v[index(gen)], v[index(gen)]);
+      }
+      break;
+    }
+
+    case Distribution::few_unique: {
+      // 16 distinct random keys
+      std::array<std::uint64_t, 16> keys;
+      std::ranges::generate(keys, gen);
+      philox::fill(v, gen(), [&](std::uint64_t random) { return keys[random % keys.size()]; });
+      break;
+    }
+
+    case Distribution::zipf: {
+      // the k-th most frequent of up to 2^20 distinct keys appears with a frequency proportional to 1 / k
+      const size_t n = std::clamp<size_t>(size, 1, 1 << 20);
+      std::vector<double> cdf(n);
+      double sum = 0.;
+      for (size_t k = 0; k < n; ++k) {
+        sum += 1. / (k + 1);
+        cdf[k] = sum;
+      }
+      philox::fill(v, gen(), [&](std::uint64_t random) {
+        double uniform = (random >> 11) * 0x1p-53 * sum;
+        size_t k = std::ranges::upper_bound(cdf, uniform) - cdf.begin();
+        return mix(std::min(k, n - 1));
+      });
+      break;
+    }
+
+    case Distribution::organ_pipe: {
+      // increasing in the first half and decreasing in the second half
+      std::vector<std::uint64_t> keys(size);
+      philox::fill_bits(keys, gen());
+      tbb::parallel_sort(keys);
+      const size_t half = (size + 1) / 2;
+      for (size_t i = 0; i < half; ++i) {
+        v[i] = keys[2 * i];
+      }
+      for (size_t i = 0; i < size - half; ++i) {
+        v[size - 1 - i] = keys[2 * i + 1];
+      }
+      break;
+    }
+  }
+  return v;
+}
+
+#endif  // distributions_h
@@ -0,0 +1,82 @@
+#ifndef merge_sort_h
+#define merge_sort_h
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// Stable merge sort, parallelised with TBB.
+//
+// The two halves of the input are sorted in parallel, and then merged in parallel: the larger of the two sorted
+// sequences is split at its middle element, the smaller one is split at the position where that element would be
+// inserted, and the two pairs of subsequences are merged independently into the two halves of the output. Each level
+// of the recursion alternates between the input and a temporary buffer, so every element is moved once per level.
+// Below a cutoff the recursion falls back to std::stable_sort and std::merge.
+
+namespace merge_sort_detail {
+
+  constexpr size_t sort_cutoff = 1 << 14;
+  constexpr size_t merge_cutoff = 1 << 14;
+
+  // merge the sorted ranges [x, x + nx) and [y, y + ny) into out; for equal elements those from x come first
+  template <typename T, typename Compare>
+  void parallel_merge(T* x, size_t nx, T* y, size_t ny, T* out, Compare const& comp) {
+    if (nx + ny <= merge_cutoff) {
+      std::merge(std::make_move_iterator(x),
+                 std::make_move_iterator(x + nx),
+                 std::make_move_iterator(y),
+                 std::make_move_iterator(y + ny),
+                 out,
+                 comp);
+      return;
+    }
+    size_t ix, iy;
+    if (nx >= ny) {
+      ix = nx / 2;
+      iy = std::lower_bound(y, y + ny, x[ix], comp) - y;
+    } else {
+      iy = ny / 2;
+      ix = std::upper_bound(x, x + nx, y[iy], comp) - x;
+    }
+    tbb::parallel_invoke([&] { parallel_merge(x, ix, y, iy, out, comp); },
+                         [&] { parallel_merge(x + ix, nx - ix, y + iy, ny - iy, out + ix + iy, comp); });
+  }
+
+  // sort [a, a + n), using [b, b + n) as temporary storage; leave the result in b if into_b is true, otherwise in a
+  template <typename T, typename Compare>
+  void parallel_sort(T* a, T* b, size_t n, bool into_b, Compare const& comp) {
+    if (n <= sort_cutoff) {
+      std::stable_sort(a, a + n, comp);
+      if (into_b) {
+        std::move(a, a + n, b);
+      }
+      return;
+    }
+    const size_t m = n / 2;
+    // sort the two halves into the other buffer, and merge them back
+    tbb::parallel_invoke([&] { parallel_sort(a, b, m, not into_b, comp); },
+                         [&] { parallel_sort(a + m, b + m, n - m, not into_b, comp); });
+    if (into_b) {
+      parallel_merge(a, m, a + m, n - m, b, comp);
+    } else {
+      parallel_merge(b, m, b + m, n - m, a, comp);
+    }
+  }
+
+}  // namespace merge_sort_detail
+
+template <typename T, typename Compare = std::less<>>
+void merge_sort(std::vector<T>& v, Compare comp = {}) {
+  if (v.size() <= merge_sort_detail::sort_cutoff) {
+    std::stable_sort(v.begin(), v.end(), comp);
+    return;
+  }
+  std::vector<T> buffer(v.size());
+  merge_sort_detail::parallel_sort(v.data(), buffer.data(), v.size(), false, comp);
+}
+
+#endif  // merge_sort_h
@@ -0,0 +1,111 @@
+#ifndef radix_sort_h
+#define radix_sort_h
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// LSD radix sort for unsigned integer keys, parallelised with TBB.
+//
+// The keys are sorted one 8-bit digit at a time, from the least to the most significant one. Each pass splits the keys
+// in blocks: first each block counts its keys with each digit value, then the counts are turned into the position
+// where each block starts writing its keys with each digit, and finally all the blocks scatter their keys in parallel
+// into a second buffer. The blocks keep the relative order of their keys and write them in block order, so every pass
+// is stable, as required by an LSD radix sort.
+// The passes where all the keys have the same digit leave the keys in place, and are skipped.
+
+template <std::unsigned_integral T>
+void radix_sort(std::vector<T>& v) {
+  constexpr int bits = 8;
+  constexpr int buckets = 1 << bits;
+  constexpr int passes = sizeof(T) * 8 / bits;
+  constexpr size_t min_block_size = 1 << 16;
+
+  const size_t size = v.size();
+  if (size < 2) {
+    return;
+  }
+
+  // a few blocks per thread, to balance the load, but not too small, to amortise the cost of the histograms
+  const size_t max_blocks = 4 * tbb::this_task_arena::max_concurrency();
+  const size_t blocks = std::clamp<size_t>(size / min_block_size, 1, max_blocks);
+  const size_t block_size = (size + blocks - 1) / blocks;
+
+  // histograms of all the digits over all the keys, computed with a single read of the input
+  using Histograms = std::array<std::array<size_t, buckets>, passes>;
+  Histograms total = tbb::parallel_reduce(
+      tbb::blocked_range<size_t>{0, size, min_block_size},
+      Histograms{},
+      [&](tbb::blocked_range<size_t> const& range, Histograms h) -> Histograms {
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+          for (int pass = 0; pass < passes; ++pass) {
+            ++h[pass][(v[i] >> (pass * bits)) & (buckets - 1)];
+          }
+        }
+        return h;
+      },
+      [](Histograms a, Histograms const& b) -> Histograms {
+        for (int pass = 0; pass < passes; ++pass) {
+          for (int d = 0; d < buckets; ++d) {
+            a[pass][d] += b[pass][d];
+          }
+        }
+        return a;
+      });
+
+  std::vector<T> buffer(size);
+  T* src = v.data();
+  T* dst = buffer.data();
+  std::vector<std::array<size_t, buckets>> offsets(blocks);
+
+  for (int pass = 0; pass < passes; ++pass) {
+    if (std::ranges::find(total[pass], size) != total[pass].end()) {
+      continue;
+    }
+    const int shift = pass * bits;
+
+    // count the keys of each block by digit
+    tbb::parallel_for(size_t{0}, blocks, [&](size_t b) {
+      auto& count = offsets[b];
+      count.fill(0);
+      const size_t end = std::min(size, (b + 1) * block_size);
+      for (size_t i = b * block_size; i < end; ++i) {
+        ++count[(src[i] >> shift) & (buckets - 1)];
+      }
+    });
+
+    // the keys with digit d from block b go after all the keys with a smaller digit, and after the keys with digit d
+    // from the previous blocks
+    size_t offset = 0;
+    for (int d = 0; d < buckets; ++d) {
+      for (size_t b = 0; b < blocks; ++b) {
+        size_t count = offsets[b][d];
+        offsets[b][d] = offset;
+        offset += count;
+      }
+    }
+
+    // scatter the keys of each block to their position in the output buffer
+    tbb::parallel_for(size_t{0}, blocks, [&](size_t b) {
+      auto& offset = offsets[b];
+      const size_t end = std::min(size, (b + 1) * block_size);
+      for (size_t i = b * block_size; i < end; ++i) {
+        T key = src[i];
+        dst[offset[(key >> shift) & (buckets - 1)]++] = key;
+      }
+    });
+
+    std::swap(src, dst);
+  }
+
+  // after an odd number of passes the sorted keys are in the temporary buffer
+  if (src != v.data()) {
+    v.swap(buffer);
+  }
+}
+
+#endif  // radix_sort_h
@@ -0,0 +1,116 @@
+#ifndef sample_sort_h
+#define sample_sort_h
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// Sample sort, parallelised with TBB.
+//
+// A random sample of the keys is sorted, and evenly spaced elements of the sample are used as splitters to partition
+// the keys in buckets; the buckets are then sorted independently. Taking oversampling keys from the sample for each
+// bucket makes the size of the buckets more even, at the cost of a larger sample to sort.
+// The partitioning works like a pass of the radix sort: the keys are split in blocks, each block counts its keys for
+// each bucket, and then scatters them in parallel into a second buffer.
+// Each splitter also has its own bucket for the keys equal to it: these need no sorting, so inputs with many repeated
+// keys do not end up with a few large buckets.
+
+template <typename T, typename Compare = std::less<>>
+void sample_sort(std::vector<T>& v, size_t oversampling = 16, Compare comp = {}) {
+  constexpr size_t min_size = 1 << 15;
+  constexpr size_t min_block_size = 1 << 14;
+
+  const size_t size = v.size();
+  const size_t concurrency = tbb::this_task_arena::max_concurrency();
+  if (size <= min_size or concurrency == 1) {
+    std::sort(v.begin(), v.end(), comp);
+    return;
+  }
+  oversampling = std::max<size_t>(oversampling, 1);
+
+  // a few buckets per thread, to balance the load
+  const size_t buckets = std::min(4 * concurrency, size / min_block_size + 1);
+  const size_t blocks = std::clamp<size_t>(size / min_block_size, 1, 4 * concurrency);
+  const size_t block_size = (size + blocks - 1) / blocks;
+
+  // pick the splitters from a sorted random sample; the generator is seeded with the size, so the same input is always
+  // partitioned in the same way
+  std::vector<T> splitters;
+  {
+    std::mt19937_64 gen{size};
+    std::uniform_int_distribution<size_t> index(0, size - 1);
+    std::vector<T> sample(buckets * oversampling);
+    std::ranges::generate(sample, [&] { return v[index(gen)]; });
+    std::sort(sample.begin(), sample.end(), comp);
+    for (size_t i = 1; i < buckets; ++i) {
+      splitters.push_back(sample[i * oversampling - 1]);
+    }
+    auto equal = [&](T const& a, T const& b) { return not comp(a, b) and not comp(b, a); };
+    splitters.erase(std::unique(splitters.begin(), splitters.end(), equal), splitters.end());
+  }
+
+  // the keys smaller than splitters[i] and larger than splitters[i-1] go in bucket 2*i; the keys equal to splitters[i]
+  // go in bucket 2*i+1
+  const size_t all_buckets = 2 * splitters.size() + 1;
+  auto classify = [&](T const& key) -> std::uint32_t {
+    size_t i = std::upper_bound(splitters.begin(), splitters.end(), key, comp) - splitters.begin();
+    if (i > 0 and not comp(splitters[i - 1], key)) {
+      return 2 * (i - 1) + 1;
+    }
+    return 2 * i;
+  };
+
+  // count the keys of each block by bucket, remembering the bucket of each key
+  std::vector<std::uint32_t> bucket(size);
+  std::vector<std::vector<size_t>> offsets(blocks, std::vector<size_t>(all_buckets, 0));
+  tbb::parallel_for(size_t{0}, blocks, [&](size_t b) {
+    auto& count = offsets[b];
+    const size_t end = std::min(size, (b + 1) * block_size);
+    for (size_t i = b * block_size; i < end; ++i) {
+      bucket[i] = classify(v[i]);
+      ++count[bucket[i]];
+    }
+  });
+
+  // the keys in bucket k from block b go after all the keys in the previous buckets, and after the keys in bucket k
+  // from the previous blocks
+  std::vector<size_t> begin(all_buckets + 1);
+  size_t offset = 0;
+  for (size_t k = 0; k < all_buckets; ++k) {
+    begin[k] = offset;
+    for (size_t b = 0; b < blocks; ++b) {
+      size_t count = offsets[b][k];
+      offsets[b][k] = offset;
+      offset += count;
+    }
+  }
+  begin[all_buckets] = size;
+
+  // scatter the keys of each block to their bucket in the output buffer
+  std::vector<T> buffer(size);
+  tbb::parallel_for(size_t{0}, blocks, [&](size_t b) {
+    auto& offset = offsets[b];
+    const size_t end = std::min(size, (b + 1) * block_size);
+    for (size_t i = b * block_size; i < end; ++i) {
+      buffer[offset[bucket[i]]++] = std::move(v[i]);
+    }
+  });
+
+  // sort each bucket, and move it back to the input
+  tbb::parallel_for(size_t{0}, all_buckets, [&](size_t k) {
+    auto first = buffer.begin() + begin[k];
+    auto last = buffer.begin() + begin[k + 1];
+    if (k % 2 == 0) {
+      std::sort(first, last, comp);
+    }
+    std::move(first, last, v.begin() + begin[k]);
+  });
+}
+
+#endif  // sample_sort_h
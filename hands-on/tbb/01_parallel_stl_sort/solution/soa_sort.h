@@ -0,0 +1,107 @@
+#ifndef soa_sort_h
+#define soa_sort_h
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "merge_sort.h"
+
+// Sort of records stored as a structure of arrays: a column of keys, and any number of payload columns of the same
+// size.
+//
+// Sorting the columns together would move every record many times. Instead each key is paired with its index, the
+// pairs are sorted by key, and the indices give the permutation that sorts the keys. The payload columns are then
+// gathered through the permutation in a single pass each. The gather reads the payload at random positions, but
+// writes it sequentially; the output is split in blocks, and every block gathers all the columns while its part of
+// the permutation is still in cache.
+// The sort is stable, so records with equal keys keep their relative order.
+
+namespace soa_sort_detail {
+
+  constexpr size_t gather_block_size = 1 << 12;
+
+  template <typename T, typename Index>
+  void gather(std::vector<T>& column,
+              std::vector<T>& out,
+              std::vector<Index> const& permutation,
+              tbb::blocked_range<size_t> const& range) {
+    for (size_t i = range.begin(); i < range.end(); ++i) {
+      out[i] = std::move(column[permutation[i]]);
+    }
+  }
+
+}  // namespace soa_sort_detail
+
+// compute the permutation that sorts the keys, i.e. keys[p[0]] <= keys[p[1]] <= ...; if sorted_keys is not null, fill
+// it with the keys in sorted order
+template <typename K, typename Compare = std::less<>>
+std::vector<std::uint32_t> sort_permutation(std::vector<K> const& keys,
+                                            std::vector<K>* sorted_keys = nullptr,
+                                            Compare comp = {}) {
+  using Index = std::uint32_t;
+  const size_t size = keys.size();
+  if (size > std::numeric_limits<Index>::max()) {
+    throw std::runtime_error("too many keys to sort with 32-bit indices");
+  }
+
+  std::vector<std::pair<K, Index>> pairs(size);
+  tbb::parallel_for(tbb::blocked_range<size_t>{0, size}, [&](tbb::blocked_range<size_t> const& range) {
+    for (size_t i = range.begin(); i < range.end(); ++i) {
+      pairs[i] = {keys[i], static_cast<Index>(i)};
+    }
+  });
+
+  merge_sort(pairs, [&](auto const& a, auto const& b) { return comp(a.first, b.first); });
+
+  std::vector<Index> permutation(size);
+  if (sorted_keys != nullptr) {
+    sorted_keys->resize(size);
+  }
+  tbb::parallel_for(tbb::blocked_range<size_t>{0, size}, [&](tbb::blocked_range<size_t> const& range) {
+    for (size_t i = range.begin(); i < range.end(); ++i) {
+      permutation[i] = pairs[i].second;
+      if (sorted_keys != nullptr) {
+        (*sorted_keys)[i] = std::move(pairs[i].first);
+      }
+    }
+  });
+  return permutation;
+}
+
+// reorder the columns according to the permutation, i.e. the p[i]-th element of each column becomes the i-th one
+template <typename Index, typename... Columns>
+void apply_permutation(std::vector<Index> const& permutation, std::vector<Columns>&... columns) {
+  const size_t size = permutation.size();
+  if (((columns.size() != size) or ...)) {
+    throw std::runtime_error("all the columns must have the same size as the permutation");
+  }
+
+  std::tuple<std::vector<Columns>...> outputs{std::vector<Columns>(size)...};
+  tbb::parallel_for(tbb::blocked_range<size_t>{0, size, soa_sort_detail::gather_block_size},
+                    [&](tbb::blocked_range<size_t> const& range) {
+                      std::apply(
+                          [&](auto&... out) { (soa_sort_detail::gather(columns, out, permutation, range), ...); },
+                          outputs);
+                    });
+  std::apply([&](auto&... out) { (columns.swap(out), ...); }, outputs);
+}
+
+// sort the keys, and reorder the payload columns in the same way
+template <typename K, typename... Columns>
+void sort_columns(std::vector<K>& keys, std::vector<Columns>&... columns) {
+  if (((columns.size() != keys.size()) or ...)) {
+    throw std::runtime_error("all the columns must have the same size as the keys");
+  }
+  std::vector<std::uint32_t> permutation = sort_permutation(keys, &keys);
+  apply_permutation(permutation, columns...);
+}
+
+#endif  // soa_sort_h
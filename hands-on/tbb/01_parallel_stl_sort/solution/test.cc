@@ -2,65 +2,244 @@
 #include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <execution>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
-bool is_sorted(std::vector<std::uint64_t> const& v) {
-  if (v.empty()) {
+#include <tbb/tbb.h>
+
+#include "bench_report.h"
+#include "distributions.h"
+#include "merge_sort.h"
+#include "radix_sort.h"
+#include "sample_sort.h"
+#include "soa_sort.h"
+#include "thread_sweep.h"
+
+// base of the tags that select the TBB sorts
+struct tbb_policy {};
+
+// tag to select the TBB radix sort instead of std::sort
+struct radix_sort_policy : tbb_policy {};
+inline constexpr radix_sort_policy radix_sort_tbb;
+
+// tag to select the TBB merge sort
+struct merge_sort_policy : tbb_policy {};
+inline constexpr merge_sort_policy merge_sort_tbb;
+
+// tag to select the TBB sample sort, with the number of sampled keys per bucket
+struct sample_sort_policy : tbb_policy {
+  size_t oversampling = 16;
+};
+
+// tag to select the TBB sort of the keys together with two payload columns
+struct soa_sort_policy : tbb_policy {};
+inline constexpr soa_sort_policy soa_sort_tbb;
+
+// The results are verified with the same policy used to sort them, so that checking a parallel sort does not take
+// longer than the sort itself. Besides being sorted, the output must be a permutation of the input: this is checked
+// comparing a checksum that does not depend on the order of the elements, the sum of a hash of each one.
+
+template <typename Policy>
+  requires std::is_execution_policy_v<Policy>
+bool is_sorted(Policy policy, std::vector<std::uint64_t> const& v) {
+  return std::is_sorted(policy, v.begin(), v.end());
+}
+
+bool is_sorted(tbb_policy, std::vector<std::uint64_t> const& v) {
+  if (v.size() < 2) {
     return true;
   }
+  // the blocks overlap by one element; the inner loop has no early exit, so it can be vectorised
+  return tbb::parallel_reduce(
+      tbb::blocked_range<size_t>{1, v.size()},
+      true,
+      [&](tbb::blocked_range<size_t> const& range, bool sorted) -> bool {
+        if (not sorted) {
+          return false;
+        }
+        bool unsorted = false;
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+          unsorted |= v[i] < v[i - 1];
+        }
+        return not unsorted;
+      },
+      std::logical_and<>());
+}
 
-  for (size_t i = 1; i < v.size(); ++i) {
-    if (v[i] < v[i - 1])
-      return false;
-  }
+template <typename Policy>
+  requires std::is_execution_policy_v<Policy>
+std::uint64_t checksum(Policy policy, std::vector<std::uint64_t> const& v) {
+  return std::transform_reduce(policy, v.begin(), v.end(), std::uint64_t{0}, std::plus<>(), mix);
+}
 
-  return true;
+std::uint64_t checksum(tbb_policy, std::vector<std::uint64_t> const& v) {
+  return tbb::parallel_reduce(
+      tbb::blocked_range<size_t>{0, v.size()},
+      std::uint64_t{0},
+      [&](tbb::blocked_range<size_t> const& range, std::uint64_t sum) -> std::uint64_t {
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+          sum += mix(v[i]);
+        }
+        return sum;
+      },
+      std::plus<>());
 }
 
-void measure(auto policy, bool verbose, std::vector<std::uint64_t> v) {
+// sort with std::sort and the given execution policy
+void run_sort(auto policy, std::vector<std::uint64_t>& v) { std::sort(policy, v.begin(), v.end()); }
+
+// sort with the TBB radix sort
+void run_sort(radix_sort_policy, std::vector<std::uint64_t>& v) { radix_sort(v); }
+
+// sort with the TBB merge sort
+void run_sort(merge_sort_policy, std::vector<std::uint64_t>& v) { merge_sort(v); }
+
+// sort with the TBB sample sort
+void run_sort(sample_sort_policy policy, std::vector<std::uint64_t>& v) { sample_sort(v, policy.oversampling); }
+
+// sort a copy of v, and return the time it took in milliseconds
+double measure(auto policy, std::vector<std::uint64_t> v) {
+  [[maybe_unused]] const std::uint64_t input = checksum(policy, v);
   const auto start = std::chrono::steady_clock::now();
-  std::sort(policy, v.begin(), v.end());
+  run_sort(policy, v);
   const auto finish = std::chrono::steady_clock::now();
-  if (verbose) {
-    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count() << "ms\n";
-  }
-  assert(is_sorted(v));
+  assert(is_sorted(policy, v));
+  assert(checksum(policy, v) == input);
+  return std::chrono::duration<double, std::milli>(finish - start).count();
 };
 
-void repeat(auto policy, std::vector<std::uint64_t> const& v, size_t times, size_t skip = 0) {
+// sort a copy of v together with two payload columns, and return the time it took in milliseconds
+double measure(soa_sort_policy, std::vector<std::uint64_t> const& v) {
+  std::vector<std::uint64_t> keys = v;
+  std::vector<std::uint32_t> index(v.size());
+  std::iota(index.begin(), index.end(), 0);
+  std::vector<double> value(v.size());
+  std::ranges::transform(v, value.begin(), [](std::uint64_t key) { return static_cast<double>(key); });
+
+  const auto start = std::chrono::steady_clock::now();
+  sort_columns(keys, index, value);
+  const auto finish = std::chrono::steady_clock::now();
+  assert(is_sorted(soa_sort_tbb, keys));
+  // the payload must have followed its keys
+  assert(tbb::parallel_reduce(
+      tbb::blocked_range<size_t>{0, keys.size()},
+      true,
+      [&](tbb::blocked_range<size_t> const& range, bool valid) -> bool {
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+          valid &= v[index[i]] == keys[i] and value[i] == static_cast<double>(keys[i]);
+        }
+        return valid;
+      },
+      std::logical_and<>()));
+  return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+std::vector<double> repeat(auto policy, std::vector<std::uint64_t> const& v, size_t times, size_t skip = 0) {
   for (size_t i = 0; i < skip; ++i) {
-    measure(policy, false, v);
+    measure(policy, v);
   }
+  std::vector<double> times_ms;
   for (size_t i = 0; i < times; ++i) {
-    measure(policy, true, v);
+    times_ms.push_back(measure(policy, v));
   }
+  return times_ms;
 }
 
-int main() {
-  const std::size_t size = 1'000'000;
-  const std::size_t skip = 1;
-  const std::size_t repeats = 10;
+// print the results on the standard output, write a benchmark record, and record them for the scaling sweep; the
+// median and the minimum are less sensitive to outliers than the mean
+class Reporter {
+public:
+  Reporter(ThreadSweep& sweep) : sweep_(sweep) {}
+
+  void header(size_t size, Distribution distribution) {
+    std::cout << size << " elements, " << name(distribution) << '\n';
+  }
+
+  void report(size_t size, Distribution distribution, std::string_view algorithm, std::vector<double> const& times) {
+    const bench_stats stats = bench_statistics(times.data(), times.size());
+    std::cout << std::fixed << std::setprecision(3) << "  " << std::left << std::setw(28) << algorithm << std::right
+              << "median " << std::setw(10) << stats.median << " ms   min " << std::setw(10) << stats.min
+              << " ms   stddev " << std::setw(8) << stats.stddev << " ms\n";
+    const int threads = tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism);
+    std::ostringstream parameters;
+    parameters << "size=" << size << ",distribution=" << name(distribution) << ",algorithm=" << algorithm;
+    bench_emit("sort", parameters.str().c_str(), "ms", stats, threads);
+    std::ostringstream label;
+    label << algorithm << ", " << size << " elements, " << name(distribution);
+    sweep_.record(label.str(), stats.median);
+  }
 
-  std::vector<std::uint64_t> v(size);
-  std::mt19937 gen{std::random_device{}()};
-  std::ranges::generate(v, gen);
+private:
+  ThreadSweep& sweep_;
+};
+
+// parse a comma-separated list of sizes, e.g. "10000,100000,1000000"
+std::vector<size_t> parse_sizes(std::string const& list) {
+  std::vector<size_t> sizes;
+  std::istringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (not item.empty()) {
+      sizes.push_back(std::stoull(item));
+    }
+  }
+  return sizes;
+}
+
+int main() {
+  std::vector<size_t> sizes = {10'000, 100'000, 1'000'000};
+  const char* sizes_env = std::getenv("SORT_SIZES");
+  if (sizes_env != nullptr and std::strlen(sizes_env) != 0) {
+    sizes = parse_sizes(sizes_env);
+  }
 
-  std::cout << "std::execution::seq\n";
-  repeat(std::execution::seq, v, repeats, skip);
-  std::cout << '\n';
+  const std::size_t skip = 1;
+  std::size_t repeats = 10;
+  const char* repeats_env = std::getenv("SORT_REPEATS");
+  if (repeats_env != nullptr and std::strlen(repeats_env) != 0) {
+    repeats = std::max(1, std::atoi(repeats_env));
+  }
 
-  std::cout << "std::execution::unseq\n";
-  repeat(std::execution::unseq, v, repeats, skip);
-  std::cout << '\n';
+  sample_sort_policy sample_sort_tbb;
+  const char* oversampling_env = std::getenv("SAMPLE_SORT_OVERSAMPLING");
+  if (oversampling_env != nullptr and std::strlen(oversampling_env) != 0) {
+    sample_sort_tbb.oversampling = std::max(1, std::atoi(oversampling_env));
+  }
 
-  std::cout << "std::execution::par\n";
-  repeat(std::execution::par, v, repeats, skip);
-  std::cout << '\n';
+  // optionally, repeat the measurements with 1, 2, 4, ... threads, on the same inputs
+  ThreadSweep sweep;
+  Reporter reporter(sweep);
+  const auto seed = std::random_device{}();
 
-  std::cout << "std::execution::par_unseq\n";
-  repeat(std::execution::par_unseq, v, repeats, skip);
-  std::cout << '\n';
+  sweep.run([&] {
+    std::mt19937_64 gen{seed};
+    for (size_t size : sizes) {
+      for (Distribution distribution : all_distributions) {
+        const std::vector<std::uint64_t> v = generate(distribution, size, gen);
+        reporter.header(size, distribution);
+        reporter.report(size, distribution, "std::execution::seq", repeat(std::execution::seq, v, repeats, skip));
+        reporter.report(size, distribution, "std::execution::unseq", repeat(std::execution::unseq, v, repeats, skip));
+        reporter.report(size, distribution, "std::execution::par", repeat(std::execution::par, v, repeats, skip));
+        reporter.report(
+            size, distribution, "std::execution::par_unseq", repeat(std::execution::par_unseq, v, repeats, skip));
+        reporter.report(size, distribution, "TBB radix sort", repeat(radix_sort_tbb, v, repeats, skip));
+        reporter.report(size, distribution, "TBB merge sort", repeat(merge_sort_tbb, v, repeats, skip));
+        reporter.report(size, distribution, "TBB sample sort", repeat(sample_sort_tbb, v, repeats, skip));
+        reporter.report(size, distribution, "TBB key + 2 columns sort", repeat(soa_sort_tbb, v, repeats, skip));
+        std::cout << '\n';
+      }
+    }
+  });
+  sweep.report(std::cout);
 }
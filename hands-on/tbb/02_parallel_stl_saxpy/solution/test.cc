@@ -1,21 +1,33 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <execution>
 //#include <format>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <numbers>
 #include <random>
+#include <span>
+#include <string>
 #include <vector>
 
+#include <tbb/tbb.h>
+
+#include "measure.h"
+#include "philox.h"
+#include "thread_sweep.h"
+
 template <typename T>
 void axpy(T a, T x, T y, T& z) {
   z = a * x + y;
 }
 
 template <typename T>
-void parallel_axpy(auto policy, T a, std::vector<T> const& x, std::vector<T> const& y, std::vector<T>& z) {
+void parallel_axpy(auto policy, T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
   std::transform(policy, x.begin(), x.end(), y.begin(), z.begin(), [a](T x, T y) -> T {
     T z;
     axpy(a, x, y, z);
@@ -24,45 +36,69 @@ void parallel_axpy(auto policy, T a, std::vector<T> const& x, std::vector<T> con
 }
 
 template <typename T>
-void measure(auto policy, T a, std::vector<T> const& x, std::vector<T> const& y) {
-  std::vector<T> z(x.size(), 0);
+float measure(auto policy, T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
   auto start = std::chrono::steady_clock::now();
   parallel_axpy(policy, a, x, y, z);
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  //std::cout << std::format("{:6.1f}", ms) << " ms\n";
-  std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms\n";
+  // throughput, counting the bytes read from x and y and written to z
+  float gbs = 3.f * x.size() * sizeof(T) / (ms * 1.e6f);
+  std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms " << std::setw(6) << gbs << " GB/s\n";
+  return ms;
+}
+
+// write to all the elements of the buffer with the same policy as the kernel, see measure_cold
+template <typename T>
+void first_touch(auto policy, std::span<T> z) {
+  std::fill(policy, z.begin(), z.end(), T{0});
 }
 
 int main() {
   const std::size_t size = 100'000'000;
   const std::size_t times = 10;
 
+  // the inputs are filled in parallel by a counter-based generator, seeded by gen
   std::mt19937 gen{std::random_device{}()};
   std::uniform_real_distribution<float> dis{-std::numbers::pi, std::numbers::pi};
   float a = dis(gen);
   std::vector<float> x(size);
-  std::ranges::generate(x, [&] { return dis(gen); });
+  philox::fill_uniform(x, dis.a(), dis.b(), gen());
   std::vector<float> y(size);
-  std::ranges::generate(y, [&] { return dis(gen); });
+  philox::fill_uniform(y, dis.a(), dis.b(), gen());
+
+  // the output buffer is allocated once, first touched in parallel, and reused by all the measurements
+  auto buffer = std::make_unique_for_overwrite<float[]>(size);
+  std::span<float> z(buffer.get(), size);
+  first_touch(std::execution::par, z);
 
-  std::cout << "std::execution::seq\n";
-  for (size_t i = 0; i < times; ++i)
-    measure(std::execution::seq, a, x, y);
-  std::cout << '\n';
+  // optionally, measure also the kernels writing to a new buffer every time
+  const char* cold_env = std::getenv("COLD_PAGES");
+  const bool cold = cold_env != nullptr and std::strlen(cold_env) != 0;
 
-  std::cout << "std::execution::unseq\n"; 
-  for (size_t i = 0; i < times; ++i)
-      measure(std::execution::unseq, a, x, y);
-  std::cout << '\n';
+  // optionally, repeat the measurements with 1, 2, 4, ... threads
+  ThreadSweep sweep;
 
-  std::cout << "std::execution::par\n";
-  for (size_t i = 0; i < times; ++i)
-    measure(std::execution::par, a, x, y);
-  std::cout << '\n';
+  auto benchmark = [&](const char* name, auto policy) {
+    if (cold) {
+      std::cout << name << ", cold pages\n";
+      auto results = measure_cold<float>(size, times, [&](std::span<float> z) { return measure(policy, a, x, y, z); });
+      emit("axpy", results, "size", size, "kernel", name, "pages", "cold");
+      std::cout << '\n';
+    }
+    std::cout << name << '\n';
+    std::vector<double> results;
+    for (size_t i = 0; i < times; ++i)
+      results.push_back(measure(policy, a, x, y, z));
+    std::cout << '\n';
+    emit("axpy", results, "size", size, "kernel", name, "pages", "warm");
+    sweep.record(name, *std::min_element(results.begin(), results.end()));
+  };
 
-  std::cout << "std::execution::par_unseq\n"; 
-  for (size_t i = 0; i < times; ++i)
-      measure(std::execution::par_unseq, a, x, y);
-  std::cout << '\n';
+  sweep.run([&] {
+    benchmark("std::execution::seq", std::execution::seq);
+    benchmark("std::execution::unseq", std::execution::unseq);
+    benchmark("std::execution::par", std::execution::par);
+    benchmark("std::execution::par_unseq", std::execution::par_unseq);
+  });
+  sweep.report(std::cout);
 }
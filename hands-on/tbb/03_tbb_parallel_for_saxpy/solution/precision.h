@@ -0,0 +1,78 @@
+#ifndef precision_h
+#define precision_h
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// Reduced precision storage formats.
+//
+// _Float16 is the IEEE 754 half precision format (5 bits of exponent, 10 bits of mantissa), supported by GCC and clang
+// as an arithmetic type; on x86 the conversions from and to float use the F16C or AVX512-FP16 instructions.
+// bfloat16 keeps the 8 bits of exponent of a float, and so its range, but only 7 bits of mantissa: it is the upper half
+// of a float. Compilers do not support it as an arithmetic type before C++23 (std::bfloat16_t), so it is implemented
+// here as a storage-only type, that is converted to float for any computation.
+
+class bfloat16 {
+public:
+  bfloat16() = default;
+
+  // round to the nearest bfloat16, with ties to even; NaNs are kept as quiet NaNs
+  explicit bfloat16(float value) {
+    std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+      bits_ = static_cast<std::uint16_t>(bits >> 16 | 0x0040);
+    } else {
+      bits_ = static_cast<std::uint16_t>((bits + 0x7fff + (bits >> 16 & 1)) >> 16);
+    }
+  }
+
+  operator float() const { return std::bit_cast<float>(static_cast<std::uint32_t>(bits_) << 16); }
+
+private:
+  std::uint16_t bits_;
+};
+
+static_assert(sizeof(bfloat16) == 2);
+
+// Convert n values from the storage type S to float, and back.
+// GCC 12 does not vectorise the conversions between _Float16 and float, and converts one value at a time; when the
+// F16C instructions are available, they are used explicitly to convert eight values at a time.
+
+template <typename S>
+void widen(S const* __restrict__ in, float* __restrict__ out, std::size_t n) {
+  std::size_t i = 0;
+#if defined(__F16C__)
+  if constexpr (std::is_same_v<S, _Float16>) {
+    for (; i + 8 <= n; i += 8) {
+      _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i))));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = static_cast<float>(in[i]);
+  }
+}
+
+template <typename S>
+void narrow(float const* __restrict__ in, S* __restrict__ out, std::size_t n) {
+  std::size_t i = 0;
+#if defined(__F16C__)
+  if constexpr (std::is_same_v<S, _Float16>) {
+    for (; i + 8 <= n; i += 8) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                       _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = static_cast<S>(in[i]);
+  }
+}
+
+#endif  // precision_h
@@ -1,20 +1,34 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 //#include <format>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <random>
+#include <span>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include <tbb/tbb.h>
 
+#include "measure.h"
+#include "philox.h"
+#include "precision.h"
+#include "thread_sweep.h"
+
 template <typename T>
 void axpy(T a, T x, T y, T& z) {
   z = a * x + y;
 }
 
 template <typename T>
-void sequential_axpy(T a, std::vector<T> const& x, std::vector<T> const& y, std::vector<T>& z) {
+void sequential_axpy(T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
   std::size_t size = x.size();
   for (std::size_t i = 0; i < size; ++i) {
     axpy(a, x[i], y[i], z[i]);
@@ -22,52 +36,310 @@ void sequential_axpy(T a, std::vector<T> const& x, std::vector<T> const& y, std:
 }
 
 template <typename T>
-void parallel_axpy(T a, std::vector<T> const& x, std::vector<T> const& y, std::vector<T>& z) {
+void parallel_axpy(T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
   std::size_t size = x.size();
   tbb::parallel_for<std::size_t>(0, size, 1, [&](std::size_t i) { axpy(a, x[i], y[i], z[i]); });
 }
 
+// vectorised axpy over a range of elements; the TBB tasks process contiguous blocks of elements, and the inner loop
+// over each block can be vectorised by the compiler
+template <typename T>
+void blocked_axpy(T a,
+                  std::vector<T> const& x,
+                  std::vector<T> const& y,
+                  std::span<T> z,
+                  tbb::affinity_partitioner& partitioner) {
+  std::size_t size = x.size();
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, size),
+      [&](tbb::blocked_range<std::size_t> const& range) {
+        T const* __restrict__ xp = x.data();
+        T const* __restrict__ yp = y.data();
+        T* __restrict__ zp = z.data();
+        for (std::size_t i = range.begin(); i < range.end(); ++i) {
+          zp[i] = a * xp[i] + yp[i];
+        }
+      },
+      partitioner);
+}
+
+// blocked axpy with the inputs and the output stored as S, and the arithmetic done in C: a narrower storage type
+// reduces the memory traffic, and a wider arithmetic type reduces the rounding errors
+template <typename S, typename C>
+void mixed_axpy(C a,
+                std::span<S const> x,
+                std::span<S const> y,
+                std::span<S> z,
+                tbb::affinity_partitioner& partitioner) {
+  std::size_t size = x.size();
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, size),
+      [&](tbb::blocked_range<std::size_t> const& range) {
+        if constexpr (std::is_same_v<S, _Float16>) {
+          // convert the elements to float and back in small chunks, that stay in the L1 cache, to vectorise the
+          // conversions; the results of the double precision arithmetic are rounded to float first
+          constexpr std::size_t chunk = 512;
+          float xf[chunk], yf[chunk], zf[chunk];
+          for (std::size_t i = range.begin(); i < range.end(); i += chunk) {
+            const std::size_t n = std::min(chunk, range.end() - i);
+            widen(x.data() + i, xf, n);
+            widen(y.data() + i, yf, n);
+            for (std::size_t j = 0; j < n; ++j) {
+              C zi;
+              axpy(a, static_cast<C>(xf[j]), static_cast<C>(yf[j]), zi);
+              zf[j] = static_cast<float>(zi);
+            }
+            narrow(zf, z.data() + i, n);
+          }
+        } else {
+          S const* __restrict__ xp = x.data();
+          S const* __restrict__ yp = y.data();
+          S* __restrict__ zp = z.data();
+          for (std::size_t i = range.begin(); i < range.end(); ++i) {
+            C zi;
+            axpy(a, static_cast<C>(xp[i]), static_cast<C>(yp[i]), zi);
+            zp[i] = static_cast<S>(zi);
+          }
+        }
+      },
+      partitioner);
+}
+
+// print the time of an axpy kernel and its throughput, counting the bytes read from x and y and written to z
+template <typename T>
+void report(float ms, std::size_t size) {
+  float gbs = 3.f * size * sizeof(T) / (ms * 1.e6f);
+  std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms " << std::setw(6) << gbs << " GB/s\n";
+}
+
 template <typename T>
-void measure_sequential(T a, std::vector<T> const& x, std::vector<T> const& y) {
-  std::vector<T> z(x.size(), 0);
+float measure_sequential(T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
   auto start = std::chrono::steady_clock::now();
   sequential_axpy(a, x, y, z);
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  //std::cout << std::format("{:6.1f}", ms) << " ms\n";
-  std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms\n";
+  report<T>(ms, x.size());
+  return ms;
 }
 
 template <typename T>
-void measure_parallel(T a, std::vector<T> const& x, std::vector<T> const& y) {
-  std::vector<T> z(x.size(), 0);
+float measure_parallel(T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
   auto start = std::chrono::steady_clock::now();
   parallel_axpy(a, x, y, z);
   auto finish = std::chrono::steady_clock::now();
   float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
-  //std::cout << std::format("{:6.1f}", ms) << " ms\n";
-  std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms\n";
+  report<T>(ms, x.size());
+  return ms;
+}
+
+// the affinity partitioner remembers which thread ran each block, and replays the same assignment when it is reused,
+// so each thread keeps working on the same part of the data, that may still be in its cache
+template <typename T>
+float measure_blocked(T a,
+                     std::vector<T> const& x,
+                     std::vector<T> const& y,
+                     std::span<T> z,
+                     tbb::affinity_partitioner& partitioner) {
+  auto start = std::chrono::steady_clock::now();
+  blocked_axpy(a, x, y, z, partitioner);
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  report<T>(ms, x.size());
+  return ms;
+}
+
+template <typename S, typename C>
+float measure_mixed(C a,
+                    std::span<S const> x,
+                    std::span<S const> y,
+                    std::span<S> z,
+                    tbb::affinity_partitioner& partitioner) {
+  auto start = std::chrono::steady_clock::now();
+  mixed_axpy(a, x, y, z, partitioner);
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  report<S>(ms, x.size());
+  return ms;
+}
+
+// write to all the elements of the buffer with the same partitioning as the blocked kernel, see measure_cold
+template <typename T>
+void first_touch(std::span<T> z, tbb::affinity_partitioner& partitioner) {
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, z.size()),
+      [&](tbb::blocked_range<std::size_t> const& range) {
+        std::fill(z.begin() + range.begin(), z.begin() + range.end(), T{0});
+      },
+      partitioner);
+}
+
+// absolute error of an axpy result, with respect to a * x + y computed in double precision from the float inputs
+struct Error {
+  double max = 0.;
+  double sum_squares = 0.;
+};
+
+template <typename S>
+Error error(float a, std::vector<float> const& x, std::vector<float> const& y, std::span<S const> z) {
+  return tbb::parallel_reduce(
+      tbb::blocked_range<std::size_t>(0, z.size()),
+      Error{},
+      [&](tbb::blocked_range<std::size_t> const& range, Error error) {
+        for (std::size_t i = range.begin(); i < range.end(); ++i) {
+          double reference = static_cast<double>(a) * x[i] + y[i];
+          double difference = std::abs(static_cast<double>(z[i]) - reference);
+          error.max = std::max(error.max, difference);
+          error.sum_squares += difference * difference;
+        }
+        return error;
+      },
+      [](Error const& a, Error const& b) { return Error{std::max(a.max, b.max), a.sum_squares + b.sum_squares}; });
+}
+
+// convert the inputs to the storage type S in parallel
+template <typename S>
+std::vector<S> convert(std::vector<float> const& v) {
+  std::vector<S> result(v.size());
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, v.size()), [&](tbb::blocked_range<std::size_t> const& range) {
+    for (std::size_t i = range.begin(); i < range.end(); ++i) {
+      result[i] = static_cast<S>(v[i]);
+    }
+  });
+  return result;
+}
+
+// measure the blocked axpy with the inputs and the output stored as S and the arithmetic done in C, and print the
+// error of its result; storage and arithmetic are the names of S and C
+template <typename S, typename C>
+void measure_precision(std::string const& storage,
+                       std::string const& arithmetic,
+                       float a,
+                       std::vector<float> const& x,
+                       std::vector<float> const& y,
+                       std::size_t times,
+                       ThreadSweep& sweep) {
+  const std::string name = storage + " storage, " + arithmetic + " arithmetic";
+  const std::size_t size = x.size();
+  std::vector<S> xs, ys;
+  std::span<S const> xv, yv;
+  if constexpr (std::is_same_v<S, float>) {
+    xv = x;
+    yv = y;
+  } else {
+    xs = convert<S>(x);
+    ys = convert<S>(y);
+    xv = xs;
+    yv = ys;
+  }
+  auto buffer = std::make_unique_for_overwrite<S[]>(size);
+  std::span<S> z(buffer.get(), size);
+  tbb::affinity_partitioner partitioner;
+  first_touch(z, partitioner);
+
+  std::cout << name << '\n';
+  std::vector<double> results;
+  for (size_t i = 0; i < times; ++i)
+    results.push_back(measure_mixed<S, C>(a, xv, yv, z, partitioner));
+  Error e = error<S>(a, x, y, z);
+  std::cout << "max error " << std::scientific << std::setprecision(2) << e.max << ", rms error "
+            << std::sqrt(e.sum_squares / size) << "\n\n";
+  emit("axpy",
+       results,
+       "size",
+       size,
+       "kernel",
+       "blocked parallel axpy",
+       "storage",
+       storage,
+       "arithmetic",
+       arithmetic,
+       "pages",
+       "warm");
+  sweep.record(name, *std::min_element(results.begin(), results.end()));
 }
 
 int main() {
   const std::size_t size = 100'000'000;
   const std::size_t times = 10;
 
+  // the inputs are filled in parallel by a counter-based generator, seeded by gen
   std::mt19937 gen{std::random_device{}()};
   std::uniform_real_distribution<float> dis{-std::numbers::pi, std::numbers::pi};
   float a = dis(gen);
   std::vector<float> x(size);
-  std::ranges::generate(x, [&] { return dis(gen); });
+  philox::fill_uniform(x, dis.a(), dis.b(), gen());
   std::vector<float> y(size);
-  std::ranges::generate(y, [&] { return dis(gen); });
+  philox::fill_uniform(y, dis.a(), dis.b(), gen());
 
-  std::cout << "sequential axpy\n";
-  for (size_t i = 0; i < times; ++i)
-    measure_sequential(a, x, y);
-  std::cout << '\n';
+  // the output buffer is allocated once, first touched in parallel, and reused by all the measurements
+  auto buffer = std::make_unique_for_overwrite<float[]>(size);
+  std::span<float> z(buffer.get(), size);
+  tbb::affinity_partitioner partitioner;
+  first_touch(z, partitioner);
 
-  std::cout << "parallel axpy\n";
-  for (size_t i = 0; i < times; ++i)
-    measure_parallel(a, x, y);
-  std::cout << '\n';
+  // optionally, measure also the kernels writing to a new buffer every time
+  const char* cold_env = std::getenv("COLD_PAGES");
+  const bool cold = cold_env != nullptr and std::strlen(cold_env) != 0;
+
+  // optionally, repeat the measurements with 1, 2, 4, ... threads
+  ThreadSweep sweep;
+  sweep.run([&] {
+    if (cold) {
+      std::cout << "sequential axpy, cold pages\n";
+      auto results =
+          measure_cold<float>(size, times, [&](std::span<float> z) { return measure_sequential(a, x, y, z); });
+      emit("axpy", results, "size", size, "kernel", "sequential axpy", "pages", "cold");
+      std::cout << '\n';
+    }
+
+    std::cout << "sequential axpy\n";
+    std::vector<double> results;
+    for (size_t i = 0; i < times; ++i)
+      results.push_back(measure_sequential(a, x, y, z));
+    std::cout << '\n';
+    emit("axpy", results, "size", size, "kernel", "sequential axpy", "pages", "warm");
+    sweep.record("sequential axpy", *std::min_element(results.begin(), results.end()));
+
+    if (cold) {
+      std::cout << "parallel axpy, cold pages\n";
+      auto results = measure_cold<float>(size, times, [&](std::span<float> z) { return measure_parallel(a, x, y, z); });
+      emit("axpy", results, "size", size, "kernel", "parallel axpy", "pages", "cold");
+      std::cout << '\n';
+    }
+
+    std::cout << "parallel axpy\n";
+    results.clear();
+    for (size_t i = 0; i < times; ++i)
+      results.push_back(measure_parallel(a, x, y, z));
+    std::cout << '\n';
+    emit("axpy", results, "size", size, "kernel", "parallel axpy", "pages", "warm");
+    sweep.record("parallel axpy", *std::min_element(results.begin(), results.end()));
+
+    if (cold) {
+      std::cout << "blocked parallel axpy, cold pages\n";
+      auto results = measure_cold<float>(size, times, [&](std::span<float> z) {
+        tbb::affinity_partitioner partitioner;
+        return measure_blocked(a, x, y, z, partitioner);
+      });
+      emit("axpy", results, "size", size, "kernel", "blocked parallel axpy", "pages", "cold");
+      std::cout << '\n';
+    }
+
+    std::cout << "blocked parallel axpy\n";
+    results.clear();
+    for (size_t i = 0; i < times; ++i)
+      results.push_back(measure_blocked(a, x, y, z, partitioner));
+    std::cout << '\n';
+    emit("axpy", results, "size", size, "kernel", "blocked parallel axpy", "pages", "warm");
+    sweep.record("blocked parallel axpy", *std::min_element(results.begin(), results.end()));
+
+    // the blocked axpy with reduced precision storage, and with double precision arithmetic
+    measure_precision<float, float>("float", "float", a, x, y, times, sweep);
+    measure_precision<float, double>("float", "double", a, x, y, times, sweep);
+    measure_precision<_Float16, float>("_Float16", "float", a, x, y, times, sweep);
+    measure_precision<_Float16, double>("_Float16", "double", a, x, y, times, sweep);
+    measure_precision<bfloat16, float>("bfloat16", "float", a, x, y, times, sweep);
+    measure_precision<bfloat16, double>("bfloat16", "double", a, x, y, times, sweep);
+  });
+  sweep.report(std::cout);
 }
@@ -25,13 +25,20 @@
 #include "fmt/core.h"
 #include "fmt/color.h"
 
+#include "image_memory.h"
+
 using namespace std::literals;
 
+// optional accounting of the memory used by the images, enabled by the MEMORY_STATS environment variable
+MemoryStats memory_stats;
+
 struct Image {
   unsigned char* data_ = nullptr;
   int width_ = 0;
   int height_ = 0;
   int channels_ = 0;
+  // graph node that allocated the image data, for the memory accounting
+  int owner_ = MemoryStats::kNoNode;
 
   Image() {}
 
@@ -40,6 +47,7 @@ struct Image {
   Image(int width, int height, int channels) : width_(width), height_(height), channels_(channels) {
     size_t size = width_ * height_ * channels_;
     data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    owner_ = memory_stats.allocate(size);
     std::memset(data_, 0x00, size);
   }
 
@@ -49,6 +57,8 @@ struct Image {
   Image(Image const& img) : width_(img.width_), height_(img.height_), channels_(img.channels_) {
     size_t size = width_ * height_ * channels_;
     data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    owner_ = memory_stats.allocate(size);
+    memory_stats.copy(size);
     std::memcpy(data_, img.data_, size);
   }
 
@@ -67,13 +77,17 @@ struct Image {
     channels_ = img.channels_;
     size_t size = width_ * height_ * channels_;
     data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    owner_ = memory_stats.allocate(size);
+    memory_stats.copy(size);
     std::memcpy(data_, img.data_, size);
 
     return *this;
   }
 
   // move constructor
-  Image(Image&& img) : data_(img.data_), width_(img.width_), height_(img.height_), channels_(img.channels_) {
+  Image(Image&& img)
+      : data_(img.data_), width_(img.width_), height_(img.height_), channels_(img.channels_), owner_(img.owner_) {
+    memory_stats.move();
     // take owndership of the image data
     img.data_ = nullptr;
   }
@@ -94,7 +108,9 @@ struct Image {
     channels_ = img.channels_;
 
     // take owndership of the image data
+    memory_stats.move();
     data_ = img.data_;
+    owner_ = img.owner_;
     img.data_ = nullptr;
 
     return *this;
@@ -107,6 +123,7 @@ struct Image {
     if (data_ == nullptr) {
       throw std::runtime_error("Failed to load "s + filename);
     }
+    owner_ = memory_stats.allocate(width_ * height_ * channels_);
     out << "Loaded image with " << width_ << " x " << height_ << " pixels and " << channels_ << " channels from "
         << filename << '\n';
   }
@@ -129,6 +146,7 @@ struct Image {
 
   void close() {
     if (data_ != nullptr) {
+      memory_stats.release(owner_, width_ * height_ * channels_);
       stbi_image_free(data_);
     }
     data_ = nullptr;
@@ -364,6 +382,11 @@ int main(int argc, const char* argv[]) {
     verbose = true;
   }
 
+  const char* memory_env = std::getenv("MEMORY_STATS");
+  if (memory_env != nullptr and std::strlen(memory_env) != 0) {
+    memory_stats.enable();
+  }
+
   std::vector<std::string> files;
   if (argc == 1) {
     // no arguments, use a single default image
@@ -391,6 +414,13 @@ int main(int argc, const char* argv[]) {
   // count how many images have been processed
   std::atomic<int> counter = 0;
 
+  // account the memory used by the images to each type of node
+  const int mem_open = memory_stats.node("open");
+  const int mem_scale = memory_stats.node("scale");
+  const int mem_gray = memory_stats.node("grayscale");
+  const int mem_tint = memory_stats.node("tint");
+  const int mem_result = memory_stats.node("result");
+
   // create a TBB flow graph
   tbb::flow::graph graph;
 
@@ -401,7 +431,10 @@ int main(int argc, const char* argv[]) {
   tbb::flow::function_node<std::string, ImagePtr> node_open(  // read the image from a file
       graph,
       tbb::flow::unlimited,
-      [](std::string filename) -> ImagePtr { return std::make_shared<Image>(filename); });
+      [mem_open](std::string filename) -> ImagePtr {
+        MemoryStats::Scope scope(mem_open);
+        return std::make_shared<Image>(filename);
+      });
 
   tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_show(  // render the image on the terminal
       graph,
@@ -411,36 +444,50 @@ int main(int argc, const char* argv[]) {
   tbb::flow::function_node<ImagePtr, ImagePtr> node_scale(  // scale down the image to 0.5x0.5
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr {
+      [mem_scale](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_scale);
         return std::make_shared<Image>(scale(*img, img->width_ * 0.5, img->height_ * 0.5));
       });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_gray(  // generate a grayscale image
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(grayscale(*img)); });
+      [mem_gray](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_gray);
+        return std::make_shared<Image>(grayscale(*img));
+      });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_tint1(  // apply a purple-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 168, 56, 172)); });
+      [mem_tint](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_tint);
+        return std::make_shared<Image>(tint(*img, 168, 56, 172));
+      });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_tint2(  // apply a green-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 100, 143, 47)); });
+      [mem_tint](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_tint);
+        return std::make_shared<Image>(tint(*img, 100, 143, 47));
+      });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_tint3(  // apply a gold-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 255, 162, 36)); });
+      [mem_tint](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_tint);
+        return std::make_shared<Image>(tint(*img, 255, 162, 36));
+      });
 
   tbb::flow::join_node<ImageCmb, tbb::flow::queueing> node_join(graph);
 
   tbb::flow::function_node<ImageCmb, ImagePtr> node_result(  // combine the images
       graph,
       tbb::flow::unlimited,
-      [](ImageCmb images) -> ImagePtr {
+      [mem_result](ImageCmb images) -> ImagePtr {
+        MemoryStats::Scope scope(mem_result);
         int width = std::get<0>(images)->width_;
         int height = std::get<0>(images)->height_;
         int channels = std::get<0>(images)->channels_;
@@ -483,5 +530,8 @@ int main(int argc, const char* argv[]) {
   // wait for all operation to complete
   graph.wait_for_all();
 
+  // report the memory used by the images, and any image still alive
+  memory_stats.report(std::cerr);
+
   return 0;
 }
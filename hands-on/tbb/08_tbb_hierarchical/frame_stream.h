@@ -0,0 +1,292 @@
+#ifndef frame_stream_h
+#define frame_stream_h
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Read and write streams of raw video frames, as concatenated binary PPM (P6) images or as a YUV4MPEG2 (Y4M) stream
+// with 4:2:0, 4:4:4 or monochrome chroma sampling.
+// Frames are always exchanged with the caller as packed 8-bit RGB pixels; Y4M frames are converted from and to
+// limited range BT.601 YUV.
+
+enum class StreamFormat { PPM, Y4M };
+
+enum class Chroma { C420, C444, Mono };
+
+// parameters of a Y4M stream, that the output stream inherits from the input stream
+struct StreamInfo {
+  StreamFormat format = StreamFormat::PPM;
+  Chroma chroma = Chroma::C420;
+  // all the tags of the Y4M stream header other than the frame size, e.g. "F30:1 Ip A1:1 C420jpeg"
+  std::string tags;
+};
+
+namespace yuv {
+
+  inline unsigned char clamp(int value) { return static_cast<unsigned char>(std::clamp(value, 0, 255)); }
+
+  // limited range BT.601, with 8 bits of fixed point precision
+  inline void to_rgb(int y, int u, int v, unsigned char* rgb) {
+    int c = 298 * (y - 16);
+    int d = u - 128;
+    int e = v - 128;
+    rgb[0] = clamp((c + 409 * e + 128) >> 8);
+    rgb[1] = clamp((c - 100 * d - 208 * e + 128) >> 8);
+    rgb[2] = clamp((c + 516 * d + 128) >> 8);
+  }
+
+  inline int luma(unsigned char const* rgb) { return ((66 * rgb[0] + 129 * rgb[1] + 25 * rgb[2] + 128) >> 8) + 16; }
+
+  inline int cb(int r, int g, int b) { return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128; }
+
+  inline int cr(int r, int g, int b) { return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128; }
+
+}  // namespace yuv
+
+class FrameReader {
+public:
+  explicit FrameReader(std::FILE* file) : file_(file) {
+    int c = std::fgetc(file_);
+    if (c == EOF) {
+      return;
+    }
+    std::ungetc(c, file_);
+    if (c == 'Y') {
+      read_y4m_header();
+    } else if (c != 'P') {
+      throw std::runtime_error("Unsupported stream format, expected PPM (P6) or YUV4MPEG2 frames");
+    }
+  }
+
+  StreamInfo const& info() const { return info_; }
+
+  // read the header of the next frame; return false at the end of the stream
+  bool next(int& width, int& height) {
+    if (info_.format == StreamFormat::Y4M) {
+      std::string line;
+      if (not read_line(line)) {
+        return false;
+      }
+      if (not line.starts_with("FRAME")) {
+        throw std::runtime_error("Invalid Y4M frame header " + line);
+      }
+    } else {
+      if (not read_ppm_header()) {
+        return false;
+      }
+    }
+    width = width_;
+    height = height_;
+    return true;
+  }
+
+  // read the pixels of the current frame, and convert them to packed RGB
+  void read(unsigned char* rgb) {
+    if (info_.format == StreamFormat::PPM) {
+      read_exactly(rgb, static_cast<size_t>(width_) * height_ * 3);
+      return;
+    }
+
+    int cw = info_.chroma == Chroma::C420 ? (width_ + 1) / 2 : width_;
+    int ch = info_.chroma == Chroma::C420 ? (height_ + 1) / 2 : height_;
+    size_t luma_size = static_cast<size_t>(width_) * height_;
+    size_t chroma_size = info_.chroma == Chroma::Mono ? 0 : static_cast<size_t>(cw) * ch;
+    planes_.resize(luma_size + 2 * chroma_size);
+    read_exactly(planes_.data(), planes_.size());
+
+    unsigned char const* py = planes_.data();
+    unsigned char const* pu = py + luma_size;
+    unsigned char const* pv = pu + chroma_size;
+    for (int y = 0; y < height_; ++y) {
+      for (int x = 0; x < width_; ++x) {
+        int u = 128;
+        int v = 128;
+        if (info_.chroma == Chroma::C420) {
+          u = pu[(y / 2) * cw + x / 2];
+          v = pv[(y / 2) * cw + x / 2];
+        } else if (info_.chroma == Chroma::C444) {
+          u = pu[y * cw + x];
+          v = pv[y * cw + x];
+        }
+        yuv::to_rgb(py[y * width_ + x], u, v, rgb + (static_cast<size_t>(y) * width_ + x) * 3);
+      }
+    }
+  }
+
+private:
+  void read_exactly(unsigned char* buffer, size_t size) {
+    if (std::fread(buffer, 1, size, file_) != size) {
+      throw std::runtime_error("Truncated frame in the input stream");
+    }
+  }
+
+  bool read_line(std::string& line) {
+    line.clear();
+    int c;
+    while ((c = std::fgetc(file_)) != EOF and c != '\n') {
+      line.push_back(static_cast<char>(c));
+    }
+    return c != EOF or not line.empty();
+  }
+
+  void read_y4m_header() {
+    std::string line;
+    read_line(line);
+    std::istringstream tokens(line);
+    std::string token;
+    tokens >> token;
+    if (token != "YUV4MPEG2") {
+      throw std::runtime_error("Invalid Y4M stream header " + line);
+    }
+    info_.format = StreamFormat::Y4M;
+    while (tokens >> token) {
+      if (token[0] == 'W') {
+        width_ = std::stoi(token.substr(1));
+      } else if (token[0] == 'H') {
+        height_ = std::stoi(token.substr(1));
+      } else {
+        if (token[0] == 'C') {
+          if (token.starts_with("C420")) {
+            info_.chroma = Chroma::C420;
+          } else if (token == "C444") {
+            info_.chroma = Chroma::C444;
+          } else if (token == "Cmono") {
+            info_.chroma = Chroma::Mono;
+          } else {
+            throw std::runtime_error("Unsupported Y4M chroma format " + token);
+          }
+        }
+        info_.tags += (info_.tags.empty() ? "" : " ") + token;
+      }
+    }
+  }
+
+  // read an unsigned integer from a PPM header, skipping whitespace and comments
+  int read_ppm_value() {
+    int c = std::fgetc(file_);
+    while (c == '#' or std::isspace(c)) {
+      if (c == '#') {
+        while (c != EOF and c != '\n') {
+          c = std::fgetc(file_);
+        }
+      }
+      c = std::fgetc(file_);
+    }
+    if (not std::isdigit(c)) {
+      throw std::runtime_error("Invalid PPM frame header");
+    }
+    int value = 0;
+    while (std::isdigit(c)) {
+      value = value * 10 + (c - '0');
+      c = std::fgetc(file_);
+    }
+    // a single whitespace character separates the header from the pixel data
+    return value;
+  }
+
+  bool read_ppm_header() {
+    int c = std::fgetc(file_);
+    while (c != EOF and std::isspace(c)) {
+      c = std::fgetc(file_);
+    }
+    if (c == EOF) {
+      return false;
+    }
+    if (c != 'P' or std::fgetc(file_) != '6') {
+      throw std::runtime_error("Unsupported frame format, only binary PPM (P6) frames are supported");
+    }
+    width_ = read_ppm_value();
+    height_ = read_ppm_value();
+    if (read_ppm_value() != 255) {
+      throw std::runtime_error("Unsupported PPM frame, only 8-bit samples are supported");
+    }
+    return true;
+  }
+
+  std::FILE* file_;
+  StreamInfo info_;
+  int width_ = 0;
+  int height_ = 0;
+  // buffer for the Y, U and V planes of a Y4M frame
+  std::vector<unsigned char> planes_;
+};
+
+class FrameWriter {
+public:
+  FrameWriter(std::FILE* file, StreamInfo info) : file_(file), info_(std::move(info)) {}
+
+  // write a frame of packed RGB pixels, and flush it immediately to keep the latency low
+  void write(unsigned char const* rgb, int width, int height) {
+    if (info_.format == StreamFormat::PPM) {
+      std::fprintf(file_, "P6\n%d %d\n255\n", width, height);
+      std::fwrite(rgb, 1, static_cast<size_t>(width) * height * 3, file_);
+      std::fflush(file_);
+      return;
+    }
+
+    if (not header_) {
+      // all the frames of a Y4M stream have the same size, given by the first one
+      std::fprintf(file_, "YUV4MPEG2 W%d H%d %s\n", width, height, info_.tags.c_str());
+      width_ = width;
+      height_ = height;
+      header_ = true;
+    }
+    if (width != width_ or height != height_) {
+      throw std::runtime_error("All the frames of a Y4M stream must have the same size");
+    }
+
+    int cw = info_.chroma == Chroma::C420 ? (width + 1) / 2 : width;
+    int ch = info_.chroma == Chroma::C420 ? (height + 1) / 2 : height;
+    size_t luma_size = static_cast<size_t>(width) * height;
+    size_t chroma_size = info_.chroma == Chroma::Mono ? 0 : static_cast<size_t>(cw) * ch;
+    planes_.resize(luma_size + 2 * chroma_size);
+    unsigned char* py = planes_.data();
+    unsigned char* pu = py + luma_size;
+    unsigned char* pv = pu + chroma_size;
+
+    for (size_t i = 0; i < luma_size; ++i) {
+      py[i] = yuv::clamp(yuv::luma(rgb + i * 3));
+    }
+    if (info_.chroma != Chroma::Mono) {
+      int step = info_.chroma == Chroma::C420 ? 2 : 1;
+      for (int y = 0; y < ch; ++y) {
+        for (int x = 0; x < cw; ++x) {
+          // average the colour over the pixels that share the same chroma sample
+          int r = 0, g = 0, b = 0, n = 0;
+          for (int j = y * step; j < std::min((y + 1) * step, height); ++j) {
+            for (int i = x * step; i < std::min((x + 1) * step, width); ++i) {
+              unsigned char const* p = rgb + (static_cast<size_t>(j) * width + i) * 3;
+              r += p[0];
+              g += p[1];
+              b += p[2];
+              ++n;
+            }
+          }
+          pu[y * cw + x] = yuv::clamp(yuv::cb(r / n, g / n, b / n));
+          pv[y * cw + x] = yuv::clamp(yuv::cr(r / n, g / n, b / n));
+        }
+      }
+    }
+
+    std::fputs("FRAME\n", file_);
+    std::fwrite(planes_.data(), 1, planes_.size(), file_);
+    std::fflush(file_);
+  }
+
+private:
+  std::FILE* file_;
+  StreamInfo info_;
+  bool header_ = false;
+  int width_ = 0;
+  int height_ = 0;
+  // buffer for the Y, U and V planes of a Y4M frame
+  std::vector<unsigned char> planes_;
+};
+
+#endif  // frame_stream_h
@@ -0,0 +1,206 @@
+#ifndef image_cache_h
+#define image_cache_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+#include "raw_image.h"
+
+// On-disk cache of decoded and processed images.
+//
+// Each entry is keyed by the hash of the content of the original file and by a description of the operations applied
+// to it (e.g. "decode", "scale 320x240"), and stores the pixels as a RawImage, so that it can be mapped back in memory
+// and used in place, instead of decoding and resampling the image again.
+// The total size of the cache is bounded: when it grows above the limit, the least recently used entries are removed.
+// The access time of an entry is tracked by its modification time, that is updated on every hit; this works across
+// different processes sharing the same cache directory.
+class ImageCache {
+public:
+  ImageCache(std::filesystem::path directory, std::uint64_t max_bytes)
+      : directory_(std::move(directory)), max_bytes_(max_bytes) {
+    std::filesystem::create_directories(directory_);
+    bytes_ = scan().second;
+  }
+
+  // hash the content of a file
+  static std::uint64_t hash_file(std::string const& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      throw std::runtime_error("Failed to open " + filename);
+    }
+    struct stat info;
+    fstat(fd, &info);
+    size_t size = info.st_size;
+    if (size == 0) {
+      ::close(fd);
+      return hash(nullptr, 0);
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      throw std::runtime_error("Failed to map " + filename);
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    std::uint64_t value = hash(static_cast<unsigned char const*>(data), size);
+    munmap(data, size);
+    return value;
+  }
+
+  // 64-bit hash of a buffer, processing four independent 64-bit lanes to use the full multiplier throughput
+  static std::uint64_t hash(unsigned char const* data, size_t size) {
+    constexpr std::uint64_t p1 = 0x9E3779B185EBCA87ull;
+    constexpr std::uint64_t p2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr std::uint64_t p3 = 0x165667B19E3779F9ull;
+    auto rotl = [](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto round = [&](std::uint64_t acc, std::uint64_t word) { return rotl(acc + word * p2, 31) * p1; };
+
+    std::uint64_t lanes[4] = {p1 + p2, p2, 0, -p1};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+      for (int l = 0; l < 4; ++l) {
+        std::uint64_t word;
+        std::memcpy(&word, data + i + 8 * l, 8);
+        lanes[l] = round(lanes[l], word);
+      }
+    }
+    std::uint64_t value = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    value += size;
+    for (; i < size; ++i) {
+      value = rotl(value ^ (data[i] * p3), 11) * p1;
+    }
+    // final avalanche
+    value ^= value >> 33;
+    value *= p2;
+    value ^= value >> 29;
+    value *= p3;
+    value ^= value >> 32;
+    return value;
+  }
+
+  // look up the result of the given operation on the file with the given hash
+  RawImage find(std::uint64_t hash, std::string const& operation) {
+    std::filesystem::path path = entry_path(hash, operation);
+    RawImage entry = RawImage::map(path);
+    if (not entry) {
+      ++misses_;
+      return entry;
+    }
+    // mark the entry as recently used
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    ++hits_;
+    return entry;
+  }
+
+  // store the result of the given operation on the file with the given hash
+  void store(std::uint64_t hash,
+             std::string const& operation,
+             int width,
+             int height,
+             int channels,
+             unsigned char const* data) {
+    // write to a temporary file and rename it, so that concurrent readers never see a partial entry
+    std::filesystem::path path = entry_path(hash, operation);
+    std::filesystem::path temp = path;
+    temp += fmt::format(".{}.{}.tmp", getpid(), temp_counter_++);
+    std::error_code error;
+    try {
+      RawImage::write(temp, data, width, height, channels);
+    } catch (std::runtime_error const&) {
+      std::filesystem::remove(temp, error);
+      return;
+    }
+    std::uint64_t size = std::filesystem::file_size(temp, error);
+    std::filesystem::rename(temp, path, error);
+    if (error) {
+      std::filesystem::remove(temp, error);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytes_ += size;
+    if (bytes_ > max_bytes_) {
+      evict();
+    }
+  }
+
+  void report(std::ostream& out) const {
+    out << fmt::format("image cache: {} hits, {} misses, {:.1f} MB in {}\n",
+                       hits_.load(),
+                       misses_.load(),
+                       bytes_ / 1048576.,
+                       directory_.string());
+  }
+
+private:
+  std::filesystem::path entry_path(std::uint64_t hash, std::string const& operation) const {
+    // hash the description of the operation as well, to build a valid file name
+    std::uint64_t op = ImageCache::hash(reinterpret_cast<unsigned char const*>(operation.data()), operation.size());
+    return directory_ / fmt::format("{:016x}-{:016x}.img", hash, op);
+  }
+
+  struct File {
+    std::filesystem::path path;
+    std::filesystem::file_time_type time;
+    std::uint64_t size;
+  };
+
+  // list all the entries in the cache, and their total size
+  std::pair<std::vector<File>, std::uint64_t> scan() const {
+    std::vector<File> files;
+    std::uint64_t total = 0;
+    std::error_code error;
+    for (auto const& item : std::filesystem::directory_iterator(directory_, error)) {
+      if (item.is_regular_file(error) and item.path().extension() == ".img") {
+        std::uint64_t size = item.file_size(error);
+        files.push_back({item.path(), item.last_write_time(error), size});
+        total += size;
+      }
+    }
+    return {std::move(files), total};
+  }
+
+  // remove the least recently used entries, until the cache is below 90% of its maximum size;
+  // must be called with the mutex held
+  void evict() {
+    auto [files, total] = scan();
+    std::sort(files.begin(), files.end(), [](File const& a, File const& b) { return a.time < b.time; });
+    std::error_code error;
+    for (auto const& file : files) {
+      if (total <= max_bytes_ / 10 * 9) {
+        break;
+      }
+      // entries that are still mapped by a reader remain valid until they are unmapped
+      if (std::filesystem::remove(file.path, error)) {
+        total -= file.size;
+      }
+    }
+    bytes_ = total;
+  }
+
+  std::filesystem::path directory_;
+  std::uint64_t max_bytes_;
+  std::uint64_t bytes_ = 0;
+  std::mutex mutex_;
+  std::atomic<std::uint64_t> hits_ = 0;
+  std::atomic<std::uint64_t> misses_ = 0;
+  std::atomic<std::uint64_t> temp_counter_ = 0;
+};
+
+#endif  // image_cache_h
@@ -0,0 +1,192 @@
+#ifndef image_quality_h
+#define image_quality_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <tbb/tbb.h>
+
+// Full-reference quality metrics for interleaved 8-bit images, used to compare the output of a fast (possibly
+// approximate) kernel with the output of a reference implementation.
+//
+// The PSNR is computed from the mean squared error over all the pixels and channels.
+// The SSIM is computed independently for each channel over 8 x 8 windows placed every 4 pixels, and averaged over all
+// the windows and channels; the windows use uniform weights, instead of the gaussian weights of the original paper.
+// Both metrics are evaluated in parallel with tbb::parallel_reduce over the rows of the images.
+
+namespace quality {
+
+  struct Result {
+    // peak signal to noise ratio, in dB; infinite for identical images
+    double psnr = std::numeric_limits<double>::infinity();
+    // structural similarity, between -1 and 1; 1 for identical images
+    double ssim = 1.;
+    // largest absolute difference between two samples
+    int max_error = 0;
+  };
+
+  // sum of the squared differences between two rows of size bytes, and their largest absolute difference
+  inline std::uint64_t squared_error(unsigned char const* a, unsigned char const* b, size_t size, int& max_error) {
+    std::uint64_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i max = zero;
+    // each 32-bit lane grows by at most 4 * 255^2 every 16 bytes, so it cannot overflow within a chunk of 16 kB
+    constexpr size_t chunk = 16 * 1024;
+    while (i + 16 <= size) {
+      __m128i acc = zero;
+      size_t end = std::min(size, i + chunk) / 16 * 16;
+      for (; i < end; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i));
+        // |a - b| with unsigned saturated arithmetic
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        max = _mm_max_epu8(max, diff);
+        // widen to 16 bits, square and sum pairs into 32 bits
+        __m128i lo = _mm_unpacklo_epi8(diff, zero);
+        __m128i hi = _mm_unpackhi_epi8(diff, zero);
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+      }
+      alignas(16) std::uint32_t partial[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(partial), acc);
+      sum += static_cast<std::uint64_t>(partial[0]) + partial[1] + partial[2] + partial[3];
+    }
+    alignas(16) unsigned char largest[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(largest), max);
+    for (unsigned char value : largest) {
+      max_error = std::max<int>(max_error, value);
+    }
+#endif
+    for (; i < size; ++i) {
+      int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+      sum += diff * diff;
+      max_error = std::max(max_error, std::abs(diff));
+    }
+    return sum;
+  }
+
+  // sums of a, b, a^2, b^2 and a*b over the samples of a window, for each channel
+  struct Moments {
+    std::uint32_t a = 0;
+    std::uint32_t b = 0;
+    std::uint32_t aa = 0;
+    std::uint32_t bb = 0;
+    std::uint32_t ab = 0;
+  };
+
+  constexpr int window = 8;
+  constexpr int window_step = 4;
+
+  // SSIM of each channel of the window with the top left corner at (x, y), summed over the channels
+  inline double ssim_window(
+      unsigned char const* a, unsigned char const* b, int width, int channels, int x, int y, std::vector<int>& sums) {
+    // accumulate the moments of each byte position along the window row, over all the rows of the window; the
+    // inner loops run over contiguous bytes and are vectorised by the compiler
+    const int size = window * channels;
+    sums.assign(5 * size, 0);
+    int* sa = sums.data();
+    int* sb = sa + size;
+    int* saa = sb + size;
+    int* sbb = saa + size;
+    int* sab = sbb + size;
+    for (int j = 0; j < window; ++j) {
+      unsigned char const* ra = a + (static_cast<size_t>(y + j) * width + x) * channels;
+      unsigned char const* rb = b + (static_cast<size_t>(y + j) * width + x) * channels;
+      for (int i = 0; i < size; ++i) {
+        int va = ra[i];
+        int vb = rb[i];
+        sa[i] += va;
+        sb[i] += vb;
+        saa[i] += va * va;
+        sbb[i] += vb * vb;
+        sab[i] += va * vb;
+      }
+    }
+
+    // fold the byte positions into the channels, and compute the SSIM of each channel
+    constexpr double c1 = (0.01 * 255) * (0.01 * 255);
+    constexpr double c2 = (0.03 * 255) * (0.03 * 255);
+    constexpr double n = window * window;
+    double total = 0.;
+    for (int c = 0; c < channels; ++c) {
+      Moments m;
+      for (int i = c; i < size; i += channels) {
+        m.a += sa[i];
+        m.b += sb[i];
+        m.aa += saa[i];
+        m.bb += sbb[i];
+        m.ab += sab[i];
+      }
+      double mean_a = m.a / n;
+      double mean_b = m.b / n;
+      double var_a = m.aa / n - mean_a * mean_a;
+      double var_b = m.bb / n - mean_b * mean_b;
+      double cov = m.ab / n - mean_a * mean_b;
+      total += ((2. * mean_a * mean_b + c1) * (2. * cov + c2)) /
+               ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+    }
+    return total;
+  }
+
+  // compare two images with the same size and number of channels
+  inline Result compare(unsigned char const* a, unsigned char const* b, int width, int height, int channels) {
+    Result result;
+    if (width <= 0 or height <= 0) {
+      return result;
+    }
+
+    // mean squared error and largest difference
+    using Error = std::pair<std::uint64_t, int>;
+    const size_t row_size = static_cast<size_t>(width) * channels;
+    Error error = tbb::parallel_reduce(
+        tbb::blocked_range<int>{0, height},
+        Error{0, 0},
+        [&](tbb::blocked_range<int> const& range, Error partial) -> Error {
+          for (int y = range.begin(); y < range.end(); ++y) {
+            partial.first += squared_error(a + y * row_size, b + y * row_size, row_size, partial.second);
+          }
+          return partial;
+        },
+        [](Error const& x, Error const& y) -> Error { return {x.first + y.first, std::max(x.second, y.second)}; });
+    result.max_error = error.second;
+    if (error.first != 0) {
+      double mse = static_cast<double>(error.first) / (static_cast<double>(row_size) * height);
+      result.psnr = 10. * std::log10(255. * 255. / mse);
+    }
+
+    // structural similarity, over the windows that fit completely inside the images
+    if (width < window or height < window) {
+      result.ssim = error.first == 0 ? 1. : 0.;
+      return result;
+    }
+    int windows_x = (width - window) / window_step + 1;
+    int windows_y = (height - window) / window_step + 1;
+    double ssim = tbb::parallel_reduce(
+        tbb::blocked_range<int>{0, windows_y},
+        0.,
+        [&](tbb::blocked_range<int> const& range, double partial) -> double {
+          std::vector<int> sums;
+          for (int wy = range.begin(); wy < range.end(); ++wy) {
+            for (int wx = 0; wx < windows_x; ++wx) {
+              partial += ssim_window(a, b, width, channels, wx * window_step, wy * window_step, sums);
+            }
+          }
+          return partial;
+        },
+        std::plus<double>());
+    result.ssim = ssim / (static_cast<double>(windows_x) * windows_y * channels);
+    return result;
+  }
+
+}  // namespace quality
+
+#endif  // image_quality_h
@@ -0,0 +1,629 @@
+#ifndef jpeg_decoder_h
+#define jpeg_decoder_h
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// Decoder for baseline (sequential, Huffman coded, 8-bit) JPEG images, that can produce the image directly at 1/2, 1/4
+// or 1/8 of its full resolution.
+//
+// Each 8 x 8 block of DCT coefficients describes 8 x 8 pixels; to produce an image scaled down by a factor 8 / N, each
+// block is transformed directly into N x N pixels, each the average of the 8 / N x 8 / N pixels it covers. The average
+// of the 8-point basis function of frequency u over groups of r = 8 / N samples is the N-point basis function of the
+// same frequency, scaled by sin(u pi / 2N) / (r sin(u pi / 16)): the frequencies below N are attenuated, and the
+// higher ones alias onto them (frequency N vanishes, and 2N - u folds onto u with the opposite sign). So the inverse
+// transform uses all the coefficients, with an N x 8 basis in each direction; at 1/8 resolution only the DC term is
+// left. The inverse DCT, the chroma upsampling and the colour conversion run on 1/4, 1/16 or 1/64 of the pixels, and
+// the full resolution image is never stored in memory.
+//
+// Progressive and arithmetic coded images, 12-bit samples and images with 2 or 4 components are not supported: open()
+// returns false, and the caller should use a full decoder instead. Corrupt data, including Huffman tables whose codes
+// do not fit in their lengths or whose symbols are out of range, and scans that use a table that was never defined,
+// make open() or decode() throw std::runtime_error.
+
+namespace jpeg {
+
+  // position in the 8 x 8 block of the n-th coefficient in zig-zag order
+  inline constexpr std::array<std::uint8_t, 64> zigzag = {
+      0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+      41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+      30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+  class Huffman {
+  public:
+    static constexpr int lookahead = 9;
+
+    // build the decoding tables from the number of codes of each length, and their symbols; return false if there are
+    // too many codes, or if they do not fit in their lengths
+    bool build(std::uint8_t const* counts, std::uint8_t const* symbols, int size) {
+      defined_ = false;
+      if (size > 256) {
+        return false;
+      }
+      std::memcpy(symbols_.data(), symbols, size);
+      fast_length_.fill(0);
+      int code = 0;
+      int k = 0;
+      for (int length = 1; length <= 16; ++length) {
+        first_index_[length] = k;
+        first_code_[length] = code;
+        for (int i = 0; i < counts[length - 1]; ++i, ++code, ++k) {
+          // the codes of each length must fit in that many bits
+          if (code >= 1 << length) {
+            return false;
+          }
+          if (length <= lookahead) {
+            // all the lookahead bit patterns that start with this code
+            int shift = lookahead - length;
+            for (int j = code << shift; j < (code + 1) << shift; ++j) {
+              fast_length_[j] = length;
+              fast_symbol_[j] = symbols_[k];
+            }
+          }
+        }
+        last_code_[length] = counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+      }
+      defined_ = true;
+      return true;
+    }
+
+    // true if the table was defined by a valid DHT segment
+    bool defined() const { return defined_; }
+
+    template <typename Reader>
+    int decode(Reader& reader) const {
+      unsigned bits = reader.peek(lookahead);
+      if (int length = fast_length_[bits]) {
+        reader.skip(length);
+        return fast_symbol_[bits];
+      }
+      for (int length = lookahead + 1; length <= 16; ++length) {
+        int code = reader.peek(length);
+        if (code <= last_code_[length]) {
+          reader.skip(length);
+          return symbols_[first_index_[length] + code - first_code_[length]];
+        }
+      }
+      throw std::runtime_error("Corrupt JPEG data: invalid Huffman code");
+    }
+
+  private:
+    std::array<std::uint8_t, 1 << lookahead> fast_length_;
+    std::array<std::uint8_t, 1 << lookahead> fast_symbol_;
+    std::array<int, 17> first_index_;
+    std::array<int, 17> first_code_;
+    std::array<int, 17> last_code_;
+    std::array<std::uint8_t, 256> symbols_;
+    bool defined_ = false;
+  };
+
+  // read the entropy coded data of a scan, removing the stuffed zero bytes
+  class BitReader {
+  public:
+    BitReader(std::uint8_t const* data, std::uint8_t const* end) : data_(data), end_(end) {}
+
+    unsigned peek(int n) {
+      if (count_ < n) {
+        fill();
+      }
+      return static_cast<unsigned>(bits_ >> (64 - n));
+    }
+
+    void skip(int n) {
+      bits_ <<= n;
+      count_ -= n;
+    }
+
+    // read n bits and sign-extend them, as in section F.2.2.1 of the specification
+    int receive(int n) {
+      if (n == 0) {
+        return 0;
+      }
+      int value = peek(n);
+      skip(n);
+      return value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+    }
+
+    // discard any buffered bits and skip the next restart marker
+    void restart() {
+      bits_ = 0;
+      count_ = 0;
+      marker_ = false;
+      while (data_ + 1 < end_ and not(data_[0] == 0xFF and data_[1] >= 0xD0 and data_[1] <= 0xD7)) {
+        ++data_;
+      }
+      data_ = std::min(data_ + 2, end_);
+    }
+
+    // position of the first byte not consumed by the scan
+    std::uint8_t const* position() const { return data_; }
+
+  private:
+    void fill() {
+      while (count_ <= 56) {
+        unsigned byte = 0;
+        // after a marker, or at the end of the data, feed zero bits
+        if (not marker_ and data_ < end_) {
+          byte = *data_;
+          if (byte == 0xFF) {
+            unsigned next = data_ + 1 < end_ ? data_[1] : 0xD9;
+            if (next == 0x00) {
+              data_ += 2;
+            } else {
+              marker_ = true;
+              byte = 0;
+            }
+          } else {
+            ++data_;
+          }
+        }
+        bits_ |= static_cast<std::uint64_t>(byte) << (56 - count_);
+        count_ += 8;
+      }
+    }
+
+    std::uint8_t const* data_;
+    std::uint8_t const* end_;
+    std::uint64_t bits_ = 0;
+    int count_ = 0;
+    bool marker_ = false;
+  };
+
+  class Decoder {
+  public:
+    // parse the headers of a JPEG image, up to the frame header; return false if the data is not a JPEG image that
+    // this decoder supports
+    bool open(std::uint8_t const* data, size_t size) {
+      data_ = data;
+      size_ = size;
+      return parse(false);
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int channels() const { return static_cast<int>(components_.size()); }
+
+    // size of the image decoded at 1/scale of the full resolution; any partial pixel at the right and bottom edges is
+    // dropped, as when scaling the full resolution image by 1/scale
+    int scaled_width(int scale) const { return std::max(1, width_ / scale); }
+    int scaled_height(int scale) const { return std::max(1, height_ / scale); }
+
+    // decode the image at 1/scale of its full resolution, with scale equal to 1, 2, 4 or 8, into a buffer of
+    // scaled_width(scale) x scaled_height(scale) x channels() bytes
+    void decode(int scale, std::uint8_t* out) {
+      if (scale != 1 and scale != 2 and scale != 4 and scale != 8) {
+        throw std::runtime_error("JPEG images can only be decoded at 1/1, 1/2, 1/4 or 1/8 resolution");
+      }
+      block_size_ = 8 / scale;
+      // 8-point inverse DCT bases averaged over groups of 8 / n samples, for the n output samples: the n-point bases,
+      // with the normalisation of the 8-point transform, times the attenuation of the average
+      constexpr double pi = std::numbers::pi;
+      for (int n = 1; n <= 8; n *= 2) {
+        const int r = 8 / n;
+        for (int x = 0; x < n; ++x) {
+          for (int u = 0; u < 8; ++u) {
+            double c = (u == 0) ? std::sqrt(0.5) : 1.;
+            double attenuation = (u == 0) ? 1. : std::sin(u * pi / (2 * n)) / (r * std::sin(u * pi / 16));
+            basis_[n][x][u] = 0.5 * c * attenuation * std::cos((2 * x + 1) * u * pi / (2 * n));
+          }
+        }
+      }
+
+      // allocate the component planes, covering all the MCUs at the reduced resolution
+      for (auto& component : components_) {
+        // subsampled components use larger blocks, up to the full 8 x 8, so that they need no upsampling
+        component.block_w = std::bit_floor(static_cast<unsigned>(std::min(8, block_size_ * max_h_ / component.h)));
+        component.block_h = std::bit_floor(static_cast<unsigned>(std::min(8, block_size_ * max_v_ / component.v)));
+        int blocks_x = mcus_x_ * (interleaved() ? component.h : 1);
+        int blocks_y = mcus_y_ * (interleaved() ? component.v : 1);
+        component.stride = blocks_x * component.block_w;
+        component.plane.assign(static_cast<size_t>(component.stride) * blocks_y * component.block_h, 0);
+      }
+
+      parse(true);
+      convert(scale, out);
+    }
+
+  private:
+    struct Component {
+      int id = 0;
+      int h = 1;
+      int v = 1;
+      int quant = 0;
+      int dc_table = 0;
+      int ac_table = 0;
+      int dc_prediction = 0;
+      // size of the block of samples decoded from each 8 x 8 block of coefficients
+      int block_w = 8;
+      int block_h = 8;
+      // decoded samples at the reduced resolution
+      int stride = 0;
+      std::vector<std::uint8_t> plane;
+    };
+
+    bool interleaved() const { return components_.size() > 1; }
+
+    int read16(size_t offset) const { return (data_[offset] << 8) | data_[offset + 1]; }
+
+    // walk through the markers; if decode is false stop after the frame header, otherwise decode all the scans
+    bool parse(bool decode) {
+      if (size_ < 4 or data_[0] != 0xFF or data_[1] != 0xD8) {
+        return false;
+      }
+      size_t offset = 2;
+      while (offset + 4 <= size_) {
+        if (data_[offset] != 0xFF) {
+          throw std::runtime_error("Corrupt JPEG data: expected a marker");
+        }
+        int marker = data_[offset + 1];
+        if (marker == 0xFF) {
+          // fill byte
+          ++offset;
+          continue;
+        }
+        if (marker == 0xD9) {
+          // end of image
+          break;
+        }
+        size_t length = read16(offset + 2);
+        size_t segment = offset + 4;
+        size_t next = offset + 2 + length;
+        if (length < 2 or next > size_) {
+          throw std::runtime_error("Corrupt JPEG data: truncated segment");
+        }
+
+        switch (marker) {
+          case 0xC0:  // baseline
+          case 0xC1:  // extended sequential, Huffman coded
+            if (not decode) {
+              return read_frame(segment, length - 2);
+            }
+            break;
+          case 0xC4:
+            if (decode) {
+              read_huffman(segment, next);
+            }
+            break;
+          case 0xDB:
+            if (decode) {
+              read_quantisation(segment, next);
+            }
+            break;
+          case 0xDD:
+            if (length < 4) {
+              throw std::runtime_error("Corrupt JPEG data: truncated restart interval");
+            }
+            restart_interval_ = read16(segment);
+            break;
+          case 0xEE:
+            // Adobe segment: a transform flag of 0 means that 3-component images are RGB instead of YCbCr
+            if (not decode and length >= 14 and std::memcmp(data_ + segment, "Adobe", 5) == 0) {
+              rgb_ = data_[segment + 11] == 0;
+            }
+            break;
+          case 0xDA:
+            if (decode) {
+              next = read_scan(segment, length - 2);
+            }
+            break;
+          default:
+            // any other start of frame marker is a coding process that is not supported
+            if (marker >= 0xC2 and marker <= 0xCF and marker != 0xC4 and marker != 0xC8 and marker != 0xCC) {
+              return false;
+            }
+            // skip application and comment segments
+            break;
+        }
+        offset = next;
+      }
+      return decode;
+    }
+
+    bool read_frame(size_t offset, size_t length) {
+      if (length < 6) {
+        return false;
+      }
+      int precision = data_[offset];
+      height_ = read16(offset + 1);
+      width_ = read16(offset + 3);
+      int count = data_[offset + 5];
+      if (precision != 8 or width_ == 0 or height_ == 0 or (count != 1 and count != 3) or
+          length < 6 + 3 * static_cast<size_t>(count)) {
+        return false;
+      }
+      components_.resize(count);
+      for (int i = 0; i < count; ++i) {
+        Component& c = components_[i];
+        c.id = data_[offset + 6 + 3 * i];
+        c.h = data_[offset + 7 + 3 * i] >> 4;
+        c.v = data_[offset + 7 + 3 * i] & 0x0F;
+        c.quant = data_[offset + 8 + 3 * i] & 0x03;
+        if (c.h < 1 or c.h > 4 or c.v < 1 or c.v > 4) {
+          return false;
+        }
+        max_h_ = std::max(max_h_, c.h);
+        max_v_ = std::max(max_v_, c.v);
+      }
+      if (count == 1) {
+        // a single component is never interleaved, and its MCU is a single block
+        components_[0].h = components_[0].v = max_h_ = max_v_ = 1;
+      }
+      mcus_x_ = (width_ + 8 * max_h_ - 1) / (8 * max_h_);
+      mcus_y_ = (height_ + 8 * max_v_ - 1) / (8 * max_v_);
+      return true;
+    }
+
+    void read_huffman(size_t offset, size_t end) {
+      while (offset + 17 <= end) {
+        int type = data_[offset] >> 4;
+        int index = data_[offset] & 0x03;
+        std::uint8_t const* counts = data_ + offset + 1;
+        int total = 0;
+        for (int i = 0; i < 16; ++i) {
+          total += counts[i];
+        }
+        if (type > 1 or offset + 17 + total > end) {
+          throw std::runtime_error("Corrupt JPEG data: invalid Huffman table");
+        }
+        // the DC symbols are the sizes of the differences, up to 11 bits for 8-bit samples; the AC symbols are a run of
+        // zeros and the size of the next coefficient, up to 10 bits
+        std::uint8_t const* symbols = data_ + offset + 17;
+        bool valid = std::all_of(symbols, symbols + total, [type](int symbol) {
+          return type == 0 ? symbol <= 11 : (symbol & 0x0F) <= 10;
+        });
+        if (not valid or not(type == 0 ? dc_tables_ : ac_tables_)[index].build(counts, symbols, total)) {
+          throw std::runtime_error("Corrupt JPEG data: invalid Huffman table");
+        }
+        offset += 17 + total;
+      }
+    }
+
+    void read_quantisation(size_t offset, size_t end) {
+      while (offset < end) {
+        int precision = data_[offset] >> 4;
+        int index = data_[offset] & 0x03;
+        ++offset;
+        if (offset + (precision ? 128 : 64) > end) {
+          throw std::runtime_error("Corrupt JPEG data: invalid quantisation table");
+        }
+        for (int k = 0; k < 64; ++k) {
+          quant_[index][zigzag[k]] = precision ? read16(offset + 2 * k) : data_[offset + k];
+        }
+        offset += precision ? 128 : 64;
+      }
+    }
+
+    // decode a scan, and return the offset of the first marker after its entropy coded data
+    size_t read_scan(size_t offset, size_t length) {
+      if (length < 1) {
+        throw std::runtime_error("Corrupt JPEG data: invalid scan header");
+      }
+      int count = data_[offset];
+      if (count < 1 or count > 4 or length < 1 + 2 * static_cast<size_t>(count)) {
+        throw std::runtime_error("Corrupt JPEG data: invalid scan header");
+      }
+      std::vector<Component*> scan;
+      for (int i = 0; i < count; ++i) {
+        int id = data_[offset + 1 + 2 * i];
+        auto it = std::find_if(components_.begin(), components_.end(), [id](Component const& c) { return c.id == id; });
+        if (it == components_.end()) {
+          throw std::runtime_error("Corrupt JPEG data: unknown component in scan");
+        }
+        it->dc_table = data_[offset + 2 + 2 * i] >> 4 & 0x03;
+        it->ac_table = data_[offset + 2 + 2 * i] & 0x03;
+        if (not dc_tables_[it->dc_table].defined() or not ac_tables_[it->ac_table].defined()) {
+          throw std::runtime_error("Corrupt JPEG data: undefined Huffman table in scan");
+        }
+        it->dc_prediction = 0;
+        scan.push_back(&*it);
+      }
+
+      BitReader reader(data_ + offset + length, data_ + size_);
+      int block[64];
+      auto decode_block = [&](Component& c, int bx, int by) {
+        read_block(reader, c, block);
+        transform(c, block, bx, by);
+      };
+
+      // the restart markers separate the intervals, there is none after the last one
+      int restarts = 0;
+      int total = 0;
+      auto check_restart = [&]() {
+        if (restart_interval_ != 0 and ++restarts % restart_interval_ == 0 and restarts < total) {
+          reader.restart();
+          for (Component* c : scan) {
+            c->dc_prediction = 0;
+          }
+        }
+      };
+
+      if (count == 1 and interleaved()) {
+        // non interleaved scan of one component of a multi-component image: the MCU is a single block, and only the
+        // blocks that cover the image are coded
+        Component& c = *scan[0];
+        int blocks_x = ((width_ * c.h + max_h_ - 1) / max_h_ + 7) / 8;
+        int blocks_y = ((height_ * c.v + max_v_ - 1) / max_v_ + 7) / 8;
+        total = blocks_x * blocks_y;
+        for (int by = 0; by < blocks_y; ++by) {
+          for (int bx = 0; bx < blocks_x; ++bx) {
+            decode_block(c, bx, by);
+            check_restart();
+          }
+        }
+      } else {
+        total = mcus_x_ * mcus_y_;
+        for (int my = 0; my < mcus_y_; ++my) {
+          for (int mx = 0; mx < mcus_x_; ++mx) {
+            for (Component* c : scan) {
+              for (int v = 0; v < c->v; ++v) {
+                for (int h = 0; h < c->h; ++h) {
+                  decode_block(*c, mx * c->h + h, my * c->v + v);
+                }
+              }
+            }
+            check_restart();
+          }
+        }
+      }
+
+      // find the next marker, skipping any restart marker left at the end of the scan
+      std::uint8_t const* p = reader.position();
+      std::uint8_t const* end = data_ + size_;
+      while (p + 1 < end and not(p[0] == 0xFF and p[1] != 0x00 and p[1] != 0xFF and (p[1] < 0xD0 or p[1] > 0xD7))) {
+        ++p;
+      }
+      return p - data_;
+    }
+
+    // entropy decode and dequantise one block
+    void read_block(BitReader& reader, Component& c, int* block) {
+      std::fill(block, block + 64, 0);
+      Huffman const& dc = dc_tables_[c.dc_table];
+      Huffman const& ac = ac_tables_[c.ac_table];
+      auto const& quant = quant_[c.quant];
+
+      c.dc_prediction += reader.receive(dc.decode(reader));
+      block[0] = c.dc_prediction * quant[0];
+      for (int k = 1; k < 64;) {
+        int symbol = ac.decode(reader);
+        int run = symbol >> 4;
+        int size = symbol & 0x0F;
+        if (size == 0) {
+          if (run != 15) {
+            // end of block
+            break;
+          }
+          // run of 16 zeros
+          k += 16;
+          continue;
+        }
+        k += run;
+        if (k > 63) {
+          throw std::runtime_error("Corrupt JPEG data: too many coefficients in a block");
+        }
+        int value = reader.receive(size);
+        int n = zigzag[k];
+        block[n] = value * quant[n];
+        ++k;
+      }
+    }
+
+    // inverse DCT of a block into block_w x block_h samples of the component plane
+    void transform(Component& c, int const* block, int bx, int by) {
+      const int nx = c.block_w;
+      const int ny = c.block_h;
+      std::uint8_t* out = c.plane.data() + static_cast<size_t>(by) * ny * c.stride + bx * nx;
+      if (nx == 1 and ny == 1) {
+        out[0] = clamp(block[0] / 8.f + 128.f);
+        return;
+      }
+      // transform the columns, then the rows; most columns have only zero coefficients at the higher frequencies
+      float tmp[8][8];
+      for (int u = 0; u < 8; ++u) {
+        bool zero = true;
+        for (int v = 0; v < 8; ++v) {
+          zero = zero and block[v * 8 + u] == 0;
+        }
+        if (zero) {
+          for (int y = 0; y < ny; ++y) {
+            tmp[y][u] = 0.f;
+          }
+          continue;
+        }
+        for (int y = 0; y < ny; ++y) {
+          float sum = 0.f;
+          for (int v = 0; v < 8; ++v) {
+            sum += basis_[ny][y][v] * block[v * 8 + u];
+          }
+          tmp[y][u] = sum;
+        }
+      }
+      for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+          float sum = 0.f;
+          for (int u = 0; u < 8; ++u) {
+            sum += basis_[nx][x][u] * tmp[y][u];
+          }
+          out[y * c.stride + x] = clamp(sum + 128.f);
+        }
+      }
+    }
+
+    static std::uint8_t clamp(float value) { return static_cast<std::uint8_t>(std::clamp(value + 0.5f, 0.f, 255.f)); }
+
+    // upsample any component decoded at a lower resolution, and convert the pixels to RGB
+    void convert(int scale, std::uint8_t* out) const {
+      const int width = scaled_width(scale);
+      const int height = scaled_height(scale);
+      tbb::parallel_for(tbb::blocked_range<int>{0, height}, [&](tbb::blocked_range<int> const& range) {
+        for (int y = range.begin(); y < range.end(); ++y) {
+          std::uint8_t* row = out + static_cast<size_t>(y) * width * channels();
+          if (components_.size() == 1) {
+            std::memcpy(row, components_[0].plane.data() + static_cast<size_t>(y) * components_[0].stride, width);
+            continue;
+          }
+          // the row of each component that covers this row of the image, and its horizontal sampling factor
+          std::uint8_t const* rows[3];
+          int factor[3];
+          for (int i = 0; i < 3; ++i) {
+            Component const& c = components_[i];
+            rows[i] = c.plane.data() + static_cast<size_t>(y * c.v * c.block_h / (max_v_ * block_size_)) * c.stride;
+            factor[i] = c.h * c.block_w;
+          }
+          const int full = max_h_ * block_size_;
+          for (int x = 0; x < width; ++x) {
+            int s0 = rows[0][x * factor[0] / full];
+            int s1 = rows[1][x * factor[1] / full];
+            int s2 = rows[2][x * factor[2] / full];
+            if (rgb_) {
+              row[3 * x] = s0;
+              row[3 * x + 1] = s1;
+              row[3 * x + 2] = s2;
+            } else {
+              // JFIF YCbCr to RGB conversion
+              float cb = s1 - 128.f;
+              float cr = s2 - 128.f;
+              row[3 * x] = clamp(s0 + 1.402f * cr);
+              row[3 * x + 1] = clamp(s0 - 0.344136f * cb - 0.714136f * cr);
+              row[3 * x + 2] = clamp(s0 + 1.772f * cb);
+            }
+          }
+        }
+      });
+    }
+
+    std::uint8_t const* data_ = nullptr;
+    size_t size_ = 0;
+
+    int width_ = 0;
+    int height_ = 0;
+    int max_h_ = 1;
+    int max_v_ = 1;
+    int mcus_x_ = 0;
+    int mcus_y_ = 0;
+    int restart_interval_ = 0;
+    bool rgb_ = false;
+    std::vector<Component> components_;
+
+    std::array<Huffman, 4> dc_tables_;
+    std::array<Huffman, 4> ac_tables_;
+    std::array<std::array<int, 64>, 4> quant_ = {};
+
+    int block_size_ = 8;
+    // basis_[n][x][u] is the weight of frequency u in the x-th of n averaged samples, for n = 1, 2, 4 and 8
+    float basis_[9][8][8];
+  };
+
+}  // namespace jpeg
+
+#endif  // jpeg_decoder_h
@@ -0,0 +1,163 @@
+#ifndef mpi_driver_h
+#define mpi_driver_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <mpi.h>
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+// Helpers to distribute a batch of images across the ranks of an MPI job.
+//
+// Every rank receives the full list of files on the command line, and computes the same assignment of files to ranks,
+// so no communication is needed before the processing starts; the files must be readable from all the nodes, e.g.
+// from a shared filesystem. Each rank then processes its share of the files independently, and at the end the
+// statistics of all the ranks are collected by rank 0.
+
+namespace mpi_driver {
+
+  // assign the files to the ranks, largest first, each one to the rank with the smallest total size so far; the size
+  // of a file is used as a proxy for the time needed to decode and process it
+  inline std::vector<std::vector<int>> shard(std::vector<std::string> const& files, int ranks) {
+    std::vector<std::uint64_t> sizes(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+      std::error_code error;
+      sizes[i] = std::filesystem::file_size(files[i], error);
+      if (error) {
+        sizes[i] = 0;
+      }
+    }
+    std::vector<int> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a] > sizes[b]; });
+
+    // (total size, rank), with the least loaded rank on top
+    using Load = std::pair<std::uint64_t, int>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> load;
+    for (int rank = 0; rank < ranks; ++rank) {
+      load.push({0, rank});
+    }
+    std::vector<std::vector<int>> shards(ranks);
+    for (int index : order) {
+      auto [total, rank] = load.top();
+      load.pop();
+      shards[rank].push_back(index);
+      load.push({total + sizes[index], rank});
+    }
+    // process the files of each rank in the original order
+    for (auto& shard : shards) {
+      std::sort(shard.begin(), shard.end());
+    }
+    return shards;
+  }
+
+  // number of ranks running on the same node as the calling rank
+  inline int local_ranks() {
+    MPI_Comm local;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &local);
+    int size;
+    MPI_Comm_size(local, &size);
+    MPI_Comm_free(&local);
+    return size;
+  }
+
+  // statistics of a single rank
+  struct Stats {
+    char host[64] = {};
+    int threads = 0;
+    int images = 0;
+    // images that could not be processed because of an error
+    int failed = 0;
+    double megabytes = 0.;
+    double seconds = 0.;
+  };
+
+  // store the name of the node running the calling rank, truncated if needed
+  inline void set_host(Stats& stats) {
+    char name[MPI_MAX_PROCESSOR_NAME];
+    int length = 0;
+    MPI_Get_processor_name(name, &length);
+    length = std::min<int>(length, sizeof(stats.host) - 1);
+    std::memcpy(stats.host, name, length);
+    stats.host[length] = '\0';
+  }
+
+  // collect the statistics of all the ranks on rank 0, and print them together with the total throughput, that counts
+  // only the images processed without errors; on rank 0 return the number of images that failed on any rank, on the
+  // other ranks return 0
+  inline int report(Stats const& stats, std::ostream& out) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<Stats> all(rank == 0 ? size : 0);
+    MPI_Gather(&stats, sizeof(Stats), MPI_BYTE, all.data(), sizeof(Stats), MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+      return 0;
+    }
+
+    out << fmt::format("\n{:>4} {:<20} {:>7} {:>7} {:>7} {:>10} {:>9} {:>9} {:>9}\n",
+                       "rank",
+                       "host",
+                       "threads",
+                       "images",
+                       "failed",
+                       "MB",
+                       "time (s)",
+                       "images/s",
+                       "MB/s");
+    Stats total;
+    double max_seconds = 0.;
+    for (int r = 0; r < size; ++r) {
+      Stats const& s = all[r];
+      out << fmt::format("{:>4} {:<20} {:>7} {:>7} {:>7} {:>10.1f} {:>9.3f} {:>9.2f} {:>9.1f}\n",
+                         r,
+                         s.host,
+                         s.threads,
+                         s.images,
+                         s.failed,
+                         s.megabytes,
+                         s.seconds,
+                         s.seconds > 0. ? (s.images - s.failed) / s.seconds : 0.,
+                         s.seconds > 0. ? s.megabytes / s.seconds : 0.);
+      total.threads += s.threads;
+      total.images += s.images;
+      total.failed += s.failed;
+      total.megabytes += s.megabytes;
+      total.seconds += s.seconds;
+      max_seconds = std::max(max_seconds, s.seconds);
+    }
+    // the batch is complete when the slowest rank is done
+    out << fmt::format("{:>4} {:<20} {:>7} {:>7} {:>7} {:>10.1f} {:>9.3f} {:>9.2f} {:>9.1f}\n",
+                       "all",
+                       "",
+                       total.threads,
+                       total.images,
+                       total.failed,
+                       total.megabytes,
+                       max_seconds,
+                       max_seconds > 0. ? (total.images - total.failed) / max_seconds : 0.,
+                       max_seconds > 0. ? total.megabytes / max_seconds : 0.);
+    double mean_seconds = total.seconds / size;
+    if (mean_seconds > 0.) {
+      out << fmt::format("load imbalance (slowest / average rank): {:.2f}\n", max_seconds / mean_seconds);
+    }
+    if (total.failed > 0) {
+      out << fmt::format("{} of {} images failed\n", total.failed, total.images);
+    }
+    return total.failed;
+  }
+
+}  // namespace mpi_driver
+
+#endif  // mpi_driver_h
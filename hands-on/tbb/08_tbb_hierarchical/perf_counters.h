@@ -0,0 +1,318 @@
+#ifndef perf_counters_h
+#define perf_counters_h
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <tbb/enumerable_thread_specific.h>
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+// Optional hardware performance counters for the image kernels.
+//
+// Each thread opens its own group of counters (cycles, instructions, last level cache misses and backend stalled
+// cycles) the first time it runs an instrumented block of code; the counters are read at the beginning and at the end
+// of each block, and the differences are accumulated per kernel and per thread.
+// If the kernel has to multiplex the hardware counters among more events than the CPU can count at the same time, the
+// group is counted only for part of the time; the differences are then scaled by the ratio between the time the group
+// was enabled and the time it was actually counting, and the kernels with scaled counts are flagged in the report.
+// If the counters cannot be opened (e.g. because of /proc/sys/kernel/perf_event_paranoid, or inside a container) the
+// instrumentation prints a warning once and then does nothing.
+class PerfCounters {
+public:
+  enum Kernel { kScale, kGrayscale, kTint, kWriteTo, kTranspose, kFlip, kNumKernels };
+
+  static constexpr const char* kernel_names[kNumKernels] = {
+      "scale", "grayscale", "tint", "write_to", "transpose", "flip"};
+
+  // the hardware events, in the order in which they are added to the group
+  enum Event { kCycles, kInstructions, kCacheMisses, kStalledCycles, kNumEvents };
+
+  // the values of the counters at a given time, and the time the group has been enabled and running, in ns
+  struct Sample {
+    std::array<std::uint64_t, kNumEvents> events = {};
+    std::uint64_t enabled = 0;
+    std::uint64_t running = 0;
+  };
+
+  struct Counts {
+    std::uint64_t calls = 0;
+    std::uint64_t bytes = 0;
+    // number of measurements that were scaled because the counters were multiplexed
+    std::uint64_t scaled = 0;
+    std::array<std::uint64_t, kNumEvents> events = {};
+
+    Counts& operator+=(Counts const& other) {
+      calls += other.calls;
+      bytes += other.bytes;
+      scaled += other.scaled;
+      for (int i = 0; i < kNumEvents; ++i) {
+        events[i] += other.events[i];
+      }
+      return *this;
+    }
+  };
+
+  // measure the block of code between the construction and the destruction of a Scope, and account the bytes it reads
+  // and writes to the given kernel
+  class Scope {
+  public:
+    Scope(PerfCounters& counters, Kernel kernel, std::uint64_t bytes) : counters_(counters), kernel_(kernel) {
+      if (counters_.enabled()) {
+        active_ = counters_.local().read(start_);
+        bytes_ = bytes;
+      }
+    }
+
+    ~Scope() {
+      if (active_) {
+        counters_.local().accumulate(kernel_, start_, bytes_);
+      }
+    }
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+  private:
+    PerfCounters& counters_;
+    Kernel kernel_;
+    bool active_ = false;
+    std::uint64_t bytes_ = 0;
+    Sample start_;
+  };
+
+  PerfCounters() = default;
+
+  // enable the counters; returns false if they are not supported or not allowed
+  bool enable() {
+    enabled_ = true;
+    // try to open the counters on the current thread, to report any problem early
+    Sample sample;
+    local().read(sample);
+    return enabled();
+  }
+
+  bool enabled() const { return enabled_ and not failed_.load(std::memory_order_relaxed); }
+
+  // count one invocation of a kernel
+  void count_call(Kernel kernel) {
+    if (enabled()) {
+      local().counts[kernel].calls += 1;
+    }
+  }
+
+  // print the counters accumulated by each kernel, first summed over all threads and then for each individual thread
+  void report(std::ostream& out) const {
+    if (not enabled()) {
+      return;
+    }
+
+    std::array<Counts, kNumKernels> total;
+    for (auto const& thread : threads_) {
+      for (int k = 0; k < kNumKernels; ++k) {
+        total[k] += thread.counts[k];
+      }
+    }
+
+    out << "\nhardware performance counters\n";
+    out << fmt::format("{:<12} {:>8} {:>14} {:>14} {:>6} {:>12} {:>10} {:>12}\n",
+                       "kernel",
+                       "calls",
+                       "cycles",
+                       "instructions",
+                       "IPC",
+                       "LLC misses",
+                       "stalled",
+                       "bytes/cycle");
+    bool scaled = false;
+    for (int k = 0; k < kNumKernels; ++k) {
+      print(out, kernel_names[k], total[k]);
+      scaled = scaled or total[k].scaled != 0;
+    }
+
+    int index = 0;
+    for (auto const& thread : threads_) {
+      out << fmt::format("thread {}\n", index++);
+      for (int k = 0; k < kNumKernels; ++k) {
+        if (thread.counts[k].events[kCycles] != 0) {
+          print(out, std::string("  ") + kernel_names[k], thread.counts[k]);
+        }
+      }
+    }
+    if (scaled) {
+      out << "* the counters were multiplexed, and the counts are estimated from the time they were running\n";
+    }
+  }
+
+private:
+  // the counters opened by a single thread, and the values accumulated by that thread
+  struct ThreadCounters {
+    int leader = -1;
+    std::array<int, kNumEvents> fds = {-1, -1, -1, -1};
+    // position of each event in the group read format, or -1 if the event is not available
+    std::array<int, kNumEvents> index = {-1, -1, -1, -1};
+    int size = 0;
+    bool opened = false;
+    std::array<Counts, kNumKernels> counts;
+    PerfCounters* parent = nullptr;
+
+    ThreadCounters() = default;
+    ThreadCounters(ThreadCounters const&) = delete;
+    ThreadCounters& operator=(ThreadCounters const&) = delete;
+
+    ~ThreadCounters() {
+#ifdef __linux__
+      for (int fd : fds) {
+        if (fd != -1) {
+          ::close(fd);
+        }
+      }
+#endif
+    }
+
+    void open() {
+      opened = true;
+#ifdef __linux__
+      static constexpr std::array<std::uint64_t, kNumEvents> configs = {PERF_COUNT_HW_CPU_CYCLES,
+                                                                        PERF_COUNT_HW_INSTRUCTIONS,
+                                                                        PERF_COUNT_HW_CACHE_MISSES,
+                                                                        PERF_COUNT_HW_STALLED_CYCLES_BACKEND};
+      for (int e = 0; e < kNumEvents; ++e) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[e];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = (leader == -1) ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // count the calling thread, on any cpu
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+        if (fd == -1) {
+          if (e == kCycles) {
+            // without the cycles counter the measurements are meaningless
+            parent->fail(fmt::format("cannot open the cycles counter: {}", std::strerror(errno)));
+            return;
+          }
+          // other events may not be supported by every CPU, e.g. backend stalls on recent Intel cores
+          continue;
+        }
+        if (leader == -1) {
+          leader = fd;
+        }
+        fds[e] = fd;
+        index[e] = size++;
+      }
+      ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+      parent->fail("hardware performance counters are supported only on Linux");
+#endif
+    }
+
+    // read the current value of all counters; returns false if they are not available
+    bool read(Sample& sample) {
+      if (not opened) {
+        open();
+      }
+      if (leader == -1) {
+        return false;
+      }
+#ifdef __linux__
+      // read format layout: the number of events, the time enabled, the time running, followed by the event values
+      std::array<std::uint64_t, kNumEvents + 3> buffer;
+      if (::read(leader, buffer.data(), sizeof(std::uint64_t) * (size + 3)) == -1) {
+        return false;
+      }
+      sample.enabled = buffer[1];
+      sample.running = buffer[2];
+      for (int e = 0; e < kNumEvents; ++e) {
+        sample.events[e] = index[e] == -1 ? 0 : buffer[index[e] + 3];
+      }
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    void accumulate(Kernel kernel, Sample const& start, std::uint64_t bytes) {
+      Sample finish;
+      if (not read(finish)) {
+        return;
+      }
+      auto& c = counts[kernel];
+      c.bytes += bytes;
+      std::uint64_t enabled = finish.enabled - start.enabled;
+      std::uint64_t running = finish.running - start.running;
+      if (running == enabled) {
+        for (int e = 0; e < kNumEvents; ++e) {
+          c.events[e] += finish.events[e] - start.events[e];
+        }
+        return;
+      }
+      // the group was counting only for part of the time, or not at all; extrapolate the counts to the whole time
+      c.scaled += 1;
+      if (running == 0) {
+        return;
+      }
+      double scale = static_cast<double>(enabled) / running;
+      for (int e = 0; e < kNumEvents; ++e) {
+        c.events[e] += static_cast<std::uint64_t>((finish.events[e] - start.events[e]) * scale);
+      }
+    }
+  };
+
+  ThreadCounters& local() {
+    bool exists;
+    auto& counters = threads_.local(exists);
+    if (not exists) {
+      counters.parent = this;
+    }
+    return counters;
+  }
+
+  void fail(std::string const& message) {
+    // report only the first failure
+    if (not failed_.exchange(true)) {
+      std::cerr << "Hardware performance counters disabled, " << message << '\n';
+    }
+  }
+
+  static void print(std::ostream& out, std::string const& name, Counts const& c) {
+    std::uint64_t cycles = c.events[kCycles];
+    std::uint64_t instructions = c.events[kInstructions];
+    double ipc = cycles ? static_cast<double>(instructions) / cycles : 0.;
+    double stalled = cycles ? 100. * c.events[kStalledCycles] / cycles : 0.;
+    double bpc = cycles ? static_cast<double>(c.bytes) / cycles : 0.;
+    out << fmt::format("{:<12} {:>8} {:>14} {:>14} {:>6.2f} {:>12} {:>9.1f}% {:>12.3f}{}\n",
+                       name,
+                       c.calls,
+                       cycles,
+                       instructions,
+                       ipc,
+                       c.events[kCacheMisses],
+                       stalled,
+                       bpc,
+                       c.scaled != 0 ? " *" : "");
+  }
+
+  bool enabled_ = false;
+  std::atomic<bool> failed_ = false;
+  tbb::enumerable_thread_specific<ThreadCounters> threads_;
+};
+
+#endif  // perf_counters_h
@@ -0,0 +1,183 @@
+#ifndef raw_image_h
+#define raw_image_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A raw, memory-mappable container for 8-bit interleaved images, used to pass intermediate results between jobs
+// running on the same host without encoding and decoding them.
+//
+// The file starts with a fixed-size header, followed by the pixel data at a page-aligned offset; each row of pixels
+// starts at a multiple of the row stride, that can be padded to any alignment (e.g. 64 bytes for aligned SIMD loads).
+// The pixel data can be mapped directly in memory and used in place, so reading an image costs only the page faults
+// needed to bring it in from the page cache.
+class RawImage {
+public:
+  static constexpr std::uint32_t version = 1;
+  static constexpr std::uint64_t page_size = 4096;
+
+  struct Header {
+    char magic[8] = {'R', 'A', 'W', 'I', 'M', 'A', 'G', 'E'};
+    std::uint32_t version = RawImage::version;
+    std::int32_t width = 0;
+    std::int32_t height = 0;
+    std::int32_t channels = 0;
+    // distance in bytes between the beginning of two consecutive rows
+    std::uint64_t stride = 0;
+    // offset in bytes of the first row from the beginning of the file
+    std::uint64_t offset = 0;
+  };
+
+  RawImage() = default;
+
+  RawImage(RawImage const&) = delete;
+  RawImage& operator=(RawImage const&) = delete;
+
+  RawImage(RawImage&& other) : mapping_(other.mapping_), size_(other.size_) { other.mapping_ = nullptr; }
+
+  RawImage& operator=(RawImage&& other) {
+    std::swap(mapping_, other.mapping_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  ~RawImage() {
+    if (mapping_ != nullptr) {
+      munmap(mapping_, size_);
+    }
+  }
+
+  // map a raw image file in memory; return an empty object if the file does not exist or is not a valid raw image
+  static RawImage map(std::string const& filename) {
+    RawImage image;
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return image;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 or static_cast<std::uint64_t>(info.st_size) < sizeof(Header)) {
+      ::close(fd);
+      return image;
+    }
+    // private, writable mapping: the pages are shared with the page cache until the image is modified in place
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      return image;
+    }
+    image.mapping_ = mapping;
+    image.size_ = info.st_size;
+
+    Header const& header = image.header();
+    if (std::memcmp(header.magic, Header().magic, sizeof(header.magic)) != 0 or header.version != version or
+        header.width < 0 or header.height < 0 or header.channels <= 0 or
+        header.stride < static_cast<std::uint64_t>(header.width) * header.channels or
+        header.offset + header.stride * header.height > image.size_) {
+      // invalid or truncated file
+      return RawImage();
+    }
+    // the pixel data will be read sequentially, and soon
+    madvise(image.mapping_, image.size_, MADV_WILLNEED);
+    return image;
+  }
+
+  // write an image of width x height pixels, with rows stride bytes apart in memory, to a raw image file;
+  // in the file each row is padded to a multiple of row_alignment bytes
+  static void write(std::string const& filename,
+                    unsigned char const* data,
+                    int width,
+                    int height,
+                    int channels,
+                    std::uint64_t stride = 0,
+                    std::uint64_t row_alignment = 1) {
+    std::uint64_t row_size = static_cast<std::uint64_t>(width) * channels;
+    if (stride == 0) {
+      stride = row_size;
+    }
+
+    Header header;
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.stride = (row_size + row_alignment - 1) / row_alignment * row_alignment;
+    header.offset = page_size;
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+      throw std::runtime_error("Error while opening raw image file " + filename);
+    }
+    // the header is padded to a full page
+    unsigned char page[page_size] = {};
+    std::memcpy(page, &header, sizeof(Header));
+    bool ok = write_all(fd, page, page_size);
+    if (header.stride == stride) {
+      // the rows have the same layout in memory and on disk, write them with a single call
+      ok = ok and write_all(fd, data, stride * height);
+    } else {
+      // write each row followed by its padding
+      std::uint64_t padding = header.stride - row_size;
+      unsigned char zeros[64] = {};
+      for (int y = 0; ok and y < height; ++y) {
+        ok = write_all(fd, data + y * stride, row_size);
+        for (std::uint64_t left = padding; ok and left > 0;) {
+          std::uint64_t size = std::min<std::uint64_t>(left, sizeof(zeros));
+          ok = write_all(fd, zeros, size);
+          left -= size;
+        }
+      }
+    }
+    ok = (::close(fd) == 0) and ok;
+    if (not ok) {
+      throw std::runtime_error("Error while writing raw image file " + filename);
+    }
+  }
+
+  explicit operator bool() const { return mapping_ != nullptr; }
+
+  Header const& header() const { return *static_cast<Header const*>(mapping_); }
+  int width() const { return header().width; }
+  int height() const { return header().height; }
+  int channels() const { return header().channels; }
+  std::uint64_t stride() const { return header().stride; }
+
+  // true if the rows are stored without any padding
+  bool packed() const { return stride() == static_cast<std::uint64_t>(width()) * channels(); }
+
+  unsigned char* data() const { return static_cast<unsigned char*>(mapping_) + header().offset; }
+
+  // give up the ownership of the mapping, that must be released with munmap(mapping, size)
+  std::pair<void*, size_t> release() {
+    std::pair<void*, size_t> mapping{mapping_, size_};
+    mapping_ = nullptr;
+    size_ = 0;
+    return mapping;
+  }
+
+private:
+  static bool write_all(int fd, void const* buffer, size_t size) {
+    auto data = static_cast<char const*>(buffer);
+    while (size > 0) {
+      ssize_t written = ::write(fd, data, size);
+      if (written <= 0) {
+        return false;
+      }
+      data += written;
+      size -= written;
+    }
+    return true;
+  }
+
+  void* mapping_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif  // raw_image_h
@@ -0,0 +1,236 @@
+#ifndef rotate_h
+#define rotate_h
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// Kernels to transpose, rotate and mirror interleaved 8-bit images with 3 (RGB) or 4 (RGBA) channels.
+//
+// A rotation by 90 or 270 degrees is a transposition followed by a mirroring along one axis, so both are implemented
+// by a single kernel that writes each transposed pixel directly to its final position. The kernel works on one tile of
+// the source image at a time, small enough that the source and destination rows it touches fit in the L1 cache and
+// in the TLB; inside each tile, blocks of 4 x 4 pixels are transposed in SIMD registers.
+// Any other number of channels is handled by a scalar fallback.
+
+namespace pixels {
+
+  // true if the SIMD kernels support images with the given number of channels
+  template <int Channels>
+#if defined(__SSSE3__)
+  inline constexpr bool simd_channels = (Channels == 3 or Channels == 4);
+#elif defined(__SSE2__)
+  inline constexpr bool simd_channels = (Channels == 4);
+#else
+  inline constexpr bool simd_channels = false;
+#endif
+
+  // copy a single pixel
+  template <int Channels>
+  inline void copy_pixel(unsigned char const* src, unsigned char* dst) {
+    std::memcpy(dst, src, Channels);
+  }
+
+  // transpose the pixels (x, y) with x0 <= x < x1 and y0 <= y < y1 of a source image of width x height pixels, and
+  // write them to the pixel
+  //   (mirror_x ? height - 1 - y : y, mirror_y ? width - 1 - x : x)
+  // of the destination image, that is height pixels wide and width pixels high
+  template <int Channels>
+  inline void transpose_tile_scalar(unsigned char const* src,
+                                    unsigned char* dst,
+                                    int width,
+                                    int height,
+                                    int x0,
+                                    int x1,
+                                    int y0,
+                                    int y1,
+                                    bool mirror_x,
+                                    bool mirror_y) {
+    for (int x = x0; x < x1; ++x) {
+      int oy = mirror_y ? width - 1 - x : x;
+      for (int y = y0; y < y1; ++y) {
+        int ox = mirror_x ? height - 1 - y : y;
+        copy_pixel<Channels>(src + (y * width + x) * Channels, dst + (oy * height + ox) * Channels);
+      }
+    }
+  }
+
+#if defined(__SSE2__)
+  // load and store 4 consecutive pixels, expanded to 32 bits each
+  template <int Channels>
+  inline __m128i load4(unsigned char const* src);
+
+  template <int Channels>
+  inline void store4(unsigned char* dst, __m128i pixels);
+
+  template <>
+  inline __m128i load4<4>(unsigned char const* src) {
+    return _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+  }
+
+  template <>
+  inline void store4<4>(unsigned char* dst, __m128i pixels) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), pixels);
+  }
+
+#if defined(__SSSE3__)
+  template <>
+  inline __m128i load4<3>(unsigned char const* src) {
+    // load exactly 12 bytes, to avoid reading past the end of the image
+    int tail;
+    std::memcpy(&tail, src + 8, 4);
+    __m128i packed = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src)), _mm_cvtsi32_si128(tail));
+    // RGB RGB RGB RGB -> RGB0 RGB0 RGB0 RGB0
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    return _mm_shuffle_epi8(packed, expand);
+  }
+
+  template <>
+  inline void store4<3>(unsigned char* dst, __m128i pixels) {
+    // RGB0 RGB0 RGB0 RGB0 -> RGB RGB RGB RGB
+    const __m128i compress = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m128i packed = _mm_shuffle_epi8(pixels, compress);
+    // store exactly 12 bytes, to avoid writing past the end of the image
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+    int tail = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+    std::memcpy(dst + 8, &tail, 4);
+  }
+#endif  // defined(__SSSE3__)
+
+  // reverse the order of the 4 pixels in a register
+  inline __m128i reverse4(__m128i pixels) { return _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+  // transpose a block of 4 x 4 pixels starting at (x, y), in registers
+  template <int Channels>
+  inline void transpose_block(unsigned char const* src,
+                              unsigned char* dst,
+                              int width,
+                              int height,
+                              int x,
+                              int y,
+                              bool mirror_x,
+                              bool mirror_y) {
+    __m128i r0 = load4<Channels>(src + ((y + 0) * width + x) * Channels);
+    __m128i r1 = load4<Channels>(src + ((y + 1) * width + x) * Channels);
+    __m128i r2 = load4<Channels>(src + ((y + 2) * width + x) * Channels);
+    __m128i r3 = load4<Channels>(src + ((y + 3) * width + x) * Channels);
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    // column i of the source block, i.e. the pixels (x + i, y ... y + 3)
+    __m128i c[4] = {_mm_unpacklo_epi64(t0, t1),
+                    _mm_unpackhi_epi64(t0, t1),
+                    _mm_unpacklo_epi64(t2, t3),
+                    _mm_unpackhi_epi64(t2, t3)};
+
+    // the 4 pixels of each column end up in consecutive pixels of the destination row, in reverse order if mirrored
+    int ox = mirror_x ? height - 4 - y : y;
+    for (int i = 0; i < 4; ++i) {
+      int oy = mirror_y ? width - 1 - (x + i) : x + i;
+      store4<Channels>(dst + (oy * height + ox) * Channels, mirror_x ? reverse4(c[i]) : c[i]);
+    }
+  }
+#endif  // defined(__SSE2__)
+
+  template <int Channels>
+  inline void transpose_tile_simd(unsigned char const* src,
+                                  unsigned char* dst,
+                                  int width,
+                                  int height,
+                                  int x0,
+                                  int x1,
+                                  int y0,
+                                  int y1,
+                                  bool mirror_x,
+                                  bool mirror_y) {
+#if defined(__SSE2__)
+    if constexpr (simd_channels<Channels>) {
+      // the largest part of the tile that is a multiple of 4 x 4 pixels
+      int x4 = x0 + (x1 - x0) / 4 * 4;
+      int y4 = y0 + (y1 - y0) / 4 * 4;
+      for (int y = y0; y < y4; y += 4) {
+        for (int x = x0; x < x4; x += 4) {
+          transpose_block<Channels>(src, dst, width, height, x, y, mirror_x, mirror_y);
+        }
+      }
+      // the remaining columns and rows
+      transpose_tile_scalar<Channels>(src, dst, width, height, x4, x1, y0, y4, mirror_x, mirror_y);
+      transpose_tile_scalar<Channels>(src, dst, width, height, x0, x1, y4, y1, mirror_x, mirror_y);
+      return;
+    }
+#endif
+    transpose_tile_scalar<Channels>(src, dst, width, height, x0, x1, y0, y1, mirror_x, mirror_y);
+  }
+
+  // transpose one tile of an image with any number of channels; see transpose_tile_scalar for the arguments
+  inline void transpose_tile(unsigned char const* src,
+                             unsigned char* dst,
+                             int width,
+                             int height,
+                             int channels,
+                             int x0,
+                             int x1,
+                             int y0,
+                             int y1,
+                             bool mirror_x,
+                             bool mirror_y) {
+    switch (channels) {
+      case 3:
+        transpose_tile_simd<3>(src, dst, width, height, x0, x1, y0, y1, mirror_x, mirror_y);
+        break;
+      case 4:
+        transpose_tile_simd<4>(src, dst, width, height, x0, x1, y0, y1, mirror_x, mirror_y);
+        break;
+      default:
+        for (int x = x0; x < x1; ++x) {
+          int oy = mirror_y ? width - 1 - x : x;
+          for (int y = y0; y < y1; ++y) {
+            int ox = mirror_x ? height - 1 - y : y;
+            std::memcpy(dst + (oy * height + ox) * channels, src + (y * width + x) * channels, channels);
+          }
+        }
+    }
+  }
+
+  // copy a row of width pixels, reversing their order
+  template <int Channels>
+  inline void reverse_row(unsigned char const* src, unsigned char* dst, int width) {
+    int x = 0;
+#if defined(__SSE2__)
+    if constexpr (simd_channels<Channels>) {
+      for (; x + 4 <= width; x += 4) {
+        store4<Channels>(dst + (width - 4 - x) * Channels, reverse4(load4<Channels>(src + x * Channels)));
+      }
+    }
+#endif
+    for (; x < width; ++x) {
+      copy_pixel<Channels>(src + x * Channels, dst + (width - 1 - x) * Channels);
+    }
+  }
+
+  inline void reverse_row(unsigned char const* src, unsigned char* dst, int width, int channels) {
+    switch (channels) {
+      case 3:
+        reverse_row<3>(src, dst, width);
+        break;
+      case 4:
+        reverse_row<4>(src, dst, width);
+        break;
+      default:
+        for (int x = 0; x < width; ++x) {
+          std::memcpy(dst + (width - 1 - x) * channels, src + x * channels, channels);
+        }
+    }
+  }
+
+}  // namespace pixels
+
+#endif  // rotate_h
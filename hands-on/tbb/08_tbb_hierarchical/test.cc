@@ -4,6 +4,8 @@
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 
@@ -24,30 +26,61 @@
 #include "fmt/core.h"
 #include "fmt/color.h"
 
+#include "frame_stream.h"
+#include "image_cache.h"
+#include "image_memory.h"
+#include "image_quality.h"
+#include "jpeg_decoder.h"
+#ifdef USE_MPI
+#include "mpi_driver.h"
+#endif
+#include "perf_counters.h"
+#include "raw_image.h"
+#include "rotate.h"
+
 using namespace std::literals;
 
+// optional accounting of the memory used by the images, enabled by the MEMORY_STATS environment variable
+MemoryStats memory_stats;
+
 struct Image {
   unsigned char* data_ = nullptr;
   int width_ = 0;
   int height_ = 0;
   int channels_ = 0;
+  // hash of the content of the file the image was read from, or 0 if it was not read from a file
+  std::uint64_t hash_ = 0;
+  // memory mapping holding the image data, if it was read from a raw image file
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  // the image was decoded at 1/reduction_ of the resolution of the file it was read from
+  int reduction_ = 1;
+  // graph node that allocated the image data, for the memory accounting
+  int owner_ = MemoryStats::kNoNode;
 
   Image() {}
 
-  Image(std::string const& filename) { open(filename); }
+  Image(std::string const& filename, int reduction = 1) { open(filename, reduction); }
+
+  // use the data of a memory-mapped raw image in place, if possible
+  Image(RawImage&& raw) { adopt(std::move(raw)); }
 
   Image(int width, int height, int channels) : width_(width), height_(height), channels_(channels) {
     size_t size = width_ * height_ * channels_;
     data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    owner_ = memory_stats.allocate(size);
     std::memset(data_, 0x00, size);
   }
 
   ~Image() { close(); }
 
   // copy constructor
-  Image(Image const& img) : width_(img.width_), height_(img.height_), channels_(img.channels_) {
+  Image(Image const& img)
+      : width_(img.width_), height_(img.height_), channels_(img.channels_), hash_(img.hash_), reduction_(img.reduction_) {
     size_t size = width_ * height_ * channels_;
     data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    owner_ = memory_stats.allocate(size);
+    memory_stats.copy(size);
     std::memcpy(data_, img.data_, size);
   }
 
@@ -64,17 +97,32 @@ struct Image {
     width_ = img.width_;
     height_ = img.height_;
     channels_ = img.channels_;
+    hash_ = img.hash_;
+    reduction_ = img.reduction_;
     size_t size = width_ * height_ * channels_;
     data_ = static_cast<unsigned char*>(stbi__malloc(size));
+    owner_ = memory_stats.allocate(size);
+    memory_stats.copy(size);
     std::memcpy(data_, img.data_, size);
 
     return *this;
   }
 
   // move constructor
-  Image(Image&& img) : data_(img.data_), width_(img.width_), height_(img.height_), channels_(img.channels_) {
+  Image(Image&& img)
+      : data_(img.data_),
+        width_(img.width_),
+        height_(img.height_),
+        channels_(img.channels_),
+        hash_(img.hash_),
+        mapping_(img.mapping_),
+        mapping_size_(img.mapping_size_),
+        reduction_(img.reduction_),
+        owner_(img.owner_) {
+    memory_stats.move();
     // take owndership of the image data
     img.data_ = nullptr;
+    img.mapping_ = nullptr;
   }
 
   // move assignment
@@ -91,21 +139,106 @@ struct Image {
     width_ = img.width_;
     height_ = img.height_;
     channels_ = img.channels_;
+    hash_ = img.hash_;
+    reduction_ = img.reduction_;
 
     // take owndership of the image data
+    memory_stats.move();
     data_ = img.data_;
+    mapping_ = img.mapping_;
+    mapping_size_ = img.mapping_size_;
+    owner_ = img.owner_;
     img.data_ = nullptr;
+    img.mapping_ = nullptr;
 
     return *this;
   }
 
-  void open(std::string const& filename) {
-    data_ = stbi_load(filename.c_str(), &width_, &height_, &channels_, 0);
+  // take ownership of a memory-mapped raw image; if its rows are padded, copy them into a packed buffer
+  void adopt(RawImage&& raw) {
+    close();
+    width_ = raw.width();
+    height_ = raw.height();
+    channels_ = raw.channels();
+    if (raw.packed()) {
+      data_ = raw.data();
+      std::tie(mapping_, mapping_size_) = raw.release();
+    } else {
+      size_t row_size = width_ * channels_;
+      data_ = static_cast<unsigned char*>(stbi__malloc(row_size * height_));
+      for (int y = 0; y < height_; ++y) {
+        std::memcpy(data_ + y * row_size, raw.data() + y * raw.stride(), row_size);
+      }
+    }
+    owner_ = memory_stats.allocate(width_ * height_ * channels_);
+  }
+
+  // read an image from a file; a baseline JPEG image can be decoded directly at 1/2, 1/4 or 1/8 of its resolution
+  void open(std::string const& filename, int reduction = 1) {
+    if (filename.ends_with(".raw")) {
+      RawImage raw = RawImage::map(filename);
+      if (not raw) {
+        throw std::runtime_error("Failed to load "s + filename);
+      }
+      adopt(std::move(raw));
+    } else {
+      if (reduction == 1 or not open_reduced(filename, reduction)) {
+        data_ = stbi_load(filename.c_str(), &width_, &height_, &channels_, 0);
+      }
+      if (data_ != nullptr) {
+        owner_ = memory_stats.allocate(width_ * height_ * channels_);
+      }
+    }
     if (data_ == nullptr) {
       throw std::runtime_error("Failed to load "s + filename);
     }
     std::cout << "Loaded image with " << width_ << " x " << height_ << " pixels and " << channels_ << " channels from "
-              << filename << '\n';
+              << filename;
+    if (reduction_ != 1) {
+      std::cout << " at 1/" << reduction_ << " resolution";
+    }
+    std::cout << '\n';
+  }
+
+  // decode a JPEG image directly at 1/reduction of its resolution, in the DCT domain; return false if the file is not
+  // a JPEG image supported by the reduced decoder
+  bool open_reduced(std::string const& filename, int reduction) {
+    if (not(filename.ends_with(".jpg") or filename.ends_with(".jpeg") or filename.ends_with(".JPG"))) {
+      return false;
+    }
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return false;
+    }
+    struct stat info;
+    void* file = MAP_FAILED;
+    if (fstat(fd, &info) == 0 and info.st_size > 0) {
+      file = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (file == MAP_FAILED) {
+      return false;
+    }
+
+    jpeg::Decoder decoder;
+    bool supported = false;
+    try {
+      if (decoder.open(static_cast<std::uint8_t const*>(file), info.st_size)) {
+        width_ = decoder.scaled_width(reduction);
+        height_ = decoder.scaled_height(reduction);
+        channels_ = decoder.channels();
+        data_ = static_cast<unsigned char*>(stbi__malloc(width_ * height_ * channels_));
+        decoder.decode(reduction, data_);
+        reduction_ = reduction;
+        supported = true;
+      }
+    } catch (std::runtime_error const&) {
+      // corrupt data, let the full decoder deal with it
+      stbi_image_free(data_);
+      data_ = nullptr;
+    }
+    munmap(file, info.st_size);
+    return supported;
   }
 
   void write(std::string const& filename) {
@@ -119,6 +252,9 @@ struct Image {
       if (status == 0) {
         throw std::runtime_error("Error while writing JPEG file "s + filename);
       }
+    } else if (filename.ends_with(".raw")) {
+      // write packed rows, so that the image can be mapped back and used in place
+      RawImage::write(filename, data_, width_, height_, channels_);
     } else {
       throw std::runtime_error("File format "s + filename + "not supported"s);
     }
@@ -126,9 +262,16 @@ struct Image {
 
   void close() {
     if (data_ != nullptr) {
+      memory_stats.release(owner_, width_ * height_ * channels_);
+    }
+    if (mapping_ != nullptr) {
+      munmap(mapping_, mapping_size_);
+    } else if (data_ != nullptr) {
       stbi_image_free(data_);
     }
     data_ = nullptr;
+    mapping_ = nullptr;
+    mapping_size_ = 0;
   }
 
   // show an image on the terminal, using up to max_width columns (with one block per column) and up to max_height lines (with two blocks per line)
@@ -178,21 +321,37 @@ struct Image {
 
 bool verbose = false;
 
-// make a scaled copy of an image
-Image scale(Image const& src, int width, int height) {
-  if (width == src.width_ and height == src.height_) {
-    // if the dimensions are the same, return a copy of the image
-    return src;
+// optional hardware performance counters, enabled by the PERF_COUNTERS environment variable
+PerfCounters perf_counters;
+
+// optional cache of decoded and scaled images, enabled by the IMAGE_CACHE environment variable
+std::unique_ptr<ImageCache> image_cache;
+
+// scale a source image to width x height pixels, and write it into a target image with the top left corner at
+// (left, top), cropping any parts that fall outside the target image; if the target image has more channels than the
+// source image, the missing channels are copied from the last channel of the source image
+void scale_into(Image const& src, Image& dst, int left, int top, int width, int height) {
+  // find the part of the scaled image that overlaps with the target image
+  int x_from = std::max(0, -left);
+  int x_to = std::min(width, dst.width_ - left);
+  int y_from = std::max(0, -top);
+  int y_to = std::min(height, dst.height_ - top);
+  if (x_from >= x_to or y_from >= y_to) {
+    return;
   }
 
-  // create a new image
-  Image out(width, height, src.channels_);
-
   auto start = std::chrono::steady_clock::now();
+  perf_counters.count_call(PerfCounters::kScale);
+
+  // each output pixel reads on average (src area / out area) source pixels
+  float read_ratio = static_cast<float>(src.width_) * src.height_ / (static_cast<float>(width) * height);
 
   tbb::parallel_for(
-      tbb::blocked_range2d<int, int>{0, height, 16, 0, width, 16},
+      tbb::blocked_range2d<int, int>{y_from, y_to, 16, x_from, x_to, 16},
       [&](tbb::blocked_range2d<int, int> const& range) {
+        std::uint64_t bytes = static_cast<std::uint64_t>(range.rows().size() * range.cols().size() * dst.channels_ *
+                                                         (1.f + read_ratio));
+        PerfCounters::Scope scope(perf_counters, PerfCounters::kScale, bytes);
         for (int y = range.rows().begin(); y < range.rows().end(); ++y) {
           // map the row of the scaled image to the nearest rows of the original image
           float yp = static_cast<float>(y) * src.height_ / height;
@@ -210,7 +369,7 @@ Image scale(Image const& src, int width, int height) {
           float dy = wy0 + wy1;
 
           for (int x = range.cols().begin(); x < range.cols().end(); ++x) {
-            int p = (y * out.width_ + x) * out.channels_;
+            int p = ((top + y) * dst.width_ + left + x) * dst.channels_;
 
             // map the column of the scaled image to the nearest columns of the original image
             float xp = static_cast<float>(x) * src.width_ / width;
@@ -233,10 +392,11 @@ Image scale(Image const& src, int width, int height) {
             int p01 = (y0 * src.width_ + x1) * src.channels_;
             int p11 = (y1 * src.width_ + x1) * src.channels_;
 
-            for (int c = 0; c < src.channels_; ++c) {
-              out.data_[p + c] = static_cast<unsigned char>(
-                  std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
-                              src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
+            for (int c = 0; c < dst.channels_; ++c) {
+              int sc = std::min(c, src.channels_ - 1);
+              dst.data_[p + c] = static_cast<unsigned char>(
+                  std::round((src.data_[p00 + sc] * wx1 * wy1 + src.data_[p10 + sc] * wx1 * wy0 +
+                              src.data_[p01 + sc] * wx0 * wy1 + src.data_[p11 + sc] * wx0 * wy0) /
                              (dx * dy)));
             }
           }
@@ -249,7 +409,74 @@ Image scale(Image const& src, int width, int height) {
   if (verbose) {
     std::cerr << fmt::format("scale:      {:6.2f}", ms) << " ms\n";
   }
+}
+
+// make a scaled copy of an image
+Image scale(Image const& src, int width, int height) {
+  if (width == src.width_ and height == src.height_) {
+    // if the dimensions are the same, return a copy of the image
+    return src;
+  }
+
+  // create a new image
+  Image out(width, height, src.channels_);
+  scale_into(src, out, 0, 0, width, height);
+
+  return out;
+}
+
+// description in the cache of the decoding of a file at 1/reduction of its resolution
+std::string decode_operation(int reduction) {
+  return reduction == 1 ? "decode"s : fmt::format("decode 1/{}", reduction);
+}
+
+// read an image from a file at 1/reduction of its resolution, or its decoded pixels from the cache
+Image open_cached(std::string const& filename, int reduction = 1) {
+  if (not image_cache) {
+    return Image(filename, reduction);
+  }
+
+  std::uint64_t hash = ImageCache::hash_file(filename);
+  std::string operation = decode_operation(reduction);
+  if (auto entry = image_cache->find(hash, operation)) {
+    Image img(std::move(entry));
+    img.hash_ = hash;
+    img.reduction_ = reduction;
+    return img;
+  }
+
+  Image img(filename, reduction);
+  img.hash_ = hash;
+  // a file that cannot be decoded at a reduced resolution is stored as a full decode
+  operation = decode_operation(img.reduction_);
+  image_cache->store(hash, operation, img.width_, img.height_, img.channels_, img.data_);
+  return img;
+}
+
+// largest reduction (1, 2, 4 or 8) at which an image can be decoded before being scaled down by the given factor,
+// without losing resolution
+int reduction_for(float factor) {
+  int reduction = 1;
+  while (reduction < 8 and factor * reduction * 2 <= 1.f) {
+    reduction *= 2;
+  }
+  return reduction;
+}
+
+// make a scaled copy of an image, or read it from the cache
+Image scale_cached(Image const& src, int width, int height) {
+  if (not image_cache or src.hash_ == 0 or (width == src.width_ and height == src.height_)) {
+    return scale(src, width, height);
+  }
+
+  // the result depends on the resolution at which the source image was decoded
+  std::string operation = fmt::format("{}, scale {}x{}", decode_operation(src.reduction_), width, height);
+  if (auto entry = image_cache->find(src.hash_, operation)) {
+    return Image(std::move(entry));
+  }
 
+  Image out = scale(src, width, height);
+  image_cache->store(src.hash_, operation, out.width_, out.height_, out.channels_, out.data_);
   return out;
 }
 
@@ -283,10 +510,15 @@ void write_to(Image const& src, Image& dst, int x, int y) {
 
   auto start = std::chrono::steady_clock::now();
 
-  tbb::parallel_for<int>(0, y_height, 1, [&](int y) {
-    int src_p = ((src_y_from + y) * src.width_ + src_x_from) * src.channels_;
-    int dst_p = ((dst_y_from + y) * dst.width_ + dst_x_from) * dst.channels_;
-    std::memcpy(dst.data_ + dst_p, src.data_ + src_p, x_width * src.channels_);
+  perf_counters.count_call(PerfCounters::kWriteTo);
+
+  tbb::parallel_for(tbb::blocked_range<int>{0, y_height}, [&](tbb::blocked_range<int> const& range) {
+    PerfCounters::Scope scope(perf_counters, PerfCounters::kWriteTo, 2ull * range.size() * x_width * src.channels_);
+    for (int y = range.begin(); y < range.end(); ++y) {
+      int src_p = ((src_y_from + y) * src.width_ + src_x_from) * src.channels_;
+      int dst_p = ((dst_y_from + y) * dst.width_ + dst_x_from) * dst.channels_;
+      std::memcpy(dst.data_ + dst_p, src.data_ + src_p, x_width * src.channels_);
+    }
   });
 
   auto finish = std::chrono::steady_clock::now();
@@ -304,17 +536,23 @@ Image grayscale(Image const& src) {
   auto start = std::chrono::steady_clock::now();
 
   Image dst = src;
-  tbb::parallel_for<int>(0, dst.height_, 1, [&](int y) {
-    for (int x = 0; x < dst.width_; ++x) {
-      int p = (y * dst.width_ + x) * dst.channels_;
-      int r = dst.data_[p];
-      int g = dst.data_[p + 1];
-      int b = dst.data_[p + 2];
-      // NTSC values for RGB to grayscale conversion
-      int y = (299 * r + 587 * g + 114 * b) / 1000;
-      dst.data_[p] = y;
-      dst.data_[p + 1] = y;
-      dst.data_[p + 2] = y;
+  perf_counters.count_call(PerfCounters::kGrayscale);
+
+  tbb::parallel_for(tbb::blocked_range<int>{0, dst.height_}, [&](tbb::blocked_range<int> const& range) {
+    PerfCounters::Scope scope(
+        perf_counters, PerfCounters::kGrayscale, 2ull * range.size() * dst.width_ * dst.channels_);
+    for (int y = range.begin(); y < range.end(); ++y) {
+      for (int x = 0; x < dst.width_; ++x) {
+        int p = (y * dst.width_ + x) * dst.channels_;
+        int r = dst.data_[p];
+        int g = dst.data_[p + 1];
+        int b = dst.data_[p + 2];
+        // NTSC values for RGB to grayscale conversion
+        int y = (299 * r + 587 * g + 114 * b) / 1000;
+        dst.data_[p] = y;
+        dst.data_[p + 1] = y;
+        dst.data_[p + 2] = y;
+      }
     }
   });
 
@@ -335,16 +573,20 @@ Image tint(Image const& src, int r, int g, int b) {
   auto start = std::chrono::steady_clock::now();
 
   Image dst = src;
-
-  tbb::parallel_for<int>(0, dst.height_, 1, [&](int y) {
-    for (int x = 0; x < dst.width_; ++x) {
-      int p = (y * dst.width_ + x) * dst.channels_;
-      int r0 = dst.data_[p];
-      int g0 = dst.data_[p + 1];
-      int b0 = dst.data_[p + 2];
-      dst.data_[p] = r0 * r / 255;
-      dst.data_[p + 1] = g0 * g / 255;
-      dst.data_[p + 2] = b0 * b / 255;
+  perf_counters.count_call(PerfCounters::kTint);
+
+  tbb::parallel_for(tbb::blocked_range<int>{0, dst.height_}, [&](tbb::blocked_range<int> const& range) {
+    PerfCounters::Scope scope(perf_counters, PerfCounters::kTint, 2ull * range.size() * dst.width_ * dst.channels_);
+    for (int y = range.begin(); y < range.end(); ++y) {
+      for (int x = 0; x < dst.width_; ++x) {
+        int p = (y * dst.width_ + x) * dst.channels_;
+        int r0 = dst.data_[p];
+        int g0 = dst.data_[p + 1];
+        int b0 = dst.data_[p + 2];
+        dst.data_[p] = r0 * r / 255;
+        dst.data_[p + 1] = g0 * g / 255;
+        dst.data_[p + 2] = b0 * b / 255;
+      }
     }
   });
 
@@ -357,21 +599,547 @@ Image tint(Image const& src, int r, int g, int b) {
   return dst;
 }
 
-int main(int argc, const char* argv[]) {
+// transpose an image, optionally mirroring the result along the X and/or Y axis
+Image transpose(Image const& src, bool mirror_x = false, bool mirror_y = false) {
+  // the transposed image has the width and height swapped
+  Image dst(src.height_, src.width_, src.channels_);
+
+  auto start = std::chrono::steady_clock::now();
+  perf_counters.count_call(PerfCounters::kTranspose);
+
+  // tiles of 32 x 32 pixels: 32 source rows and 32 destination rows of up to 128 bytes each fit in the L1 cache
+  tbb::parallel_for(
+      tbb::blocked_range2d<int, int>{0, src.height_, 32, 0, src.width_, 32},
+      [&](tbb::blocked_range2d<int, int> const& range) {
+        PerfCounters::Scope scope(
+            perf_counters, PerfCounters::kTranspose, 2ull * range.rows().size() * range.cols().size() * src.channels_);
+        pixels::transpose_tile(src.data_,
+                               dst.data_,
+                               src.width_,
+                               src.height_,
+                               src.channels_,
+                               range.cols().begin(),
+                               range.cols().end(),
+                               range.rows().begin(),
+                               range.rows().end(),
+                               mirror_x,
+                               mirror_y);
+      },
+      tbb::simple_partitioner());
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << fmt::format("transpose:  {:6.2f}", ms) << " ms\n";
+  }
+
+  return dst;
+}
+
+// mirror an image along the X axis (left to right) and/or along the Y axis (top to bottom)
+Image flip(Image const& src, bool horizontal, bool vertical) {
+  Image dst(src.width_, src.height_, src.channels_);
+
+  auto start = std::chrono::steady_clock::now();
+  perf_counters.count_call(PerfCounters::kFlip);
+
+  size_t row_size = src.width_ * src.channels_;
+  tbb::parallel_for(tbb::blocked_range<int>{0, src.height_}, [&](tbb::blocked_range<int> const& range) {
+    PerfCounters::Scope scope(perf_counters, PerfCounters::kFlip, 2ull * range.size() * row_size);
+    for (int y = range.begin(); y < range.end(); ++y) {
+      unsigned char const* src_row = src.data_ + y * row_size;
+      unsigned char* dst_row = dst.data_ + (vertical ? src.height_ - 1 - y : y) * row_size;
+      if (horizontal) {
+        pixels::reverse_row(src_row, dst_row, src.width_, src.channels_);
+      } else {
+        std::memcpy(dst_row, src_row, row_size);
+      }
+    }
+  });
+
+  auto finish = std::chrono::steady_clock::now();
+  float ms = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count() * 1000.f;
+  if (verbose) {
+    std::cerr << fmt::format("flip:       {:6.2f}", ms) << " ms\n";
+  }
+
+  return dst;
+}
+
+// rotate an image clockwise by a multiple of 90 degrees
+Image rotate(Image const& src, int degrees) {
+  switch (((degrees % 360) + 360) % 360) {
+    case 0:
+      return src;
+    case 90:
+      return transpose(src, true, false);
+    case 180:
+      return flip(src, true, true);
+    case 270:
+      return transpose(src, false, true);
+    default:
+      throw std::runtime_error(fmt::format("Rotation by {} degrees not supported", degrees));
+  }
+}
+
+// reference implementations of the image kernels, as in 04_images, used to verify the results of the optimised kernels
+namespace reference {
+
+  Image scale(Image const& src, int width, int height) {
+    if (width == src.width_ and height == src.height_) {
+      return src;
+    }
+
+    Image out(width, height, src.channels_);
+    for (int y = 0; y < height; ++y) {
+      // map the row of the scaled image to the nearest rows of the original image
+      float yp = static_cast<float>(y) * src.height_ / height;
+      int y0 = std::clamp(static_cast<int>(std::floor(yp)), 0, src.height_ - 1);
+      int y1 = std::clamp(static_cast<int>(std::ceil(yp)), 0, src.height_ - 1);
+
+      // interpolate between y0 and y1
+      float wy0 = yp - y0;
+      float wy1 = y1 - yp;
+      if (y0 == y1) {
+        wy0 = 1.f;
+        wy1 = 1.f;
+      }
+      float dy = wy0 + wy1;
+
+      for (int x = 0; x < width; ++x) {
+        int p = (y * out.width_ + x) * out.channels_;
+
+        // map the column of the scaled image to the nearest columns of the original image
+        float xp = static_cast<float>(x) * src.width_ / width;
+        int x0 = std::clamp(static_cast<int>(std::floor(xp)), 0, src.width_ - 1);
+        int x1 = std::clamp(static_cast<int>(std::ceil(xp)), 0, src.width_ - 1);
+
+        // interpolate between x0 and x1
+        float wx0 = xp - x0;
+        float wx1 = x1 - xp;
+        if (x0 == x1) {
+          wx0 = 1.f;
+          wx1 = 1.f;
+        }
+        float dx = wx0 + wx1;
+
+        // bi-linear interpolation of all channels
+        int p00 = (y0 * src.width_ + x0) * src.channels_;
+        int p10 = (y1 * src.width_ + x0) * src.channels_;
+        int p01 = (y0 * src.width_ + x1) * src.channels_;
+        int p11 = (y1 * src.width_ + x1) * src.channels_;
+
+        for (int c = 0; c < src.channels_; ++c) {
+          out.data_[p + c] =
+              static_cast<unsigned char>(std::round((src.data_[p00 + c] * wx1 * wy1 + src.data_[p10 + c] * wx1 * wy0 +
+                                                     src.data_[p01 + c] * wx0 * wy1 + src.data_[p11 + c] * wx0 * wy0) /
+                                                    (dx * dy)));
+        }
+      }
+    }
+    return out;
+  }
+
+  Image grayscale(Image const& src) {
+    assert(src.channels_ >= 3);
+
+    Image dst = src;
+    for (int y = 0; y < dst.height_; ++y) {
+      for (int x = 0; x < dst.width_; ++x) {
+        int p = (y * dst.width_ + x) * dst.channels_;
+        int r = dst.data_[p];
+        int g = dst.data_[p + 1];
+        int b = dst.data_[p + 2];
+        // NTSC values for RGB to grayscale conversion
+        int y = (299 * r + 587 * g + 114 * b) / 1000;
+        dst.data_[p] = y;
+        dst.data_[p + 1] = y;
+        dst.data_[p + 2] = y;
+      }
+    }
+    return dst;
+  }
+
+  Image tint(Image const& src, int r, int g, int b) {
+    assert(src.channels_ >= 3);
+
+    Image dst = src;
+    for (int y = 0; y < dst.height_; ++y) {
+      for (int x = 0; x < dst.width_; ++x) {
+        int p = (y * dst.width_ + x) * dst.channels_;
+        int r0 = dst.data_[p];
+        int g0 = dst.data_[p + 1];
+        int b0 = dst.data_[p + 2];
+        dst.data_[p] = r0 * r / 255;
+        dst.data_[p + 1] = g0 * g / 255;
+        dst.data_[p + 2] = b0 * b / 255;
+      }
+    }
+    return dst;
+  }
+
+}  // namespace reference
+
+// compare the outputs of the graph nodes with the reference implementations applied to the same inputs, on a sample
+// of the images, and keep track of the worst results for each kernel
+class Verifier {
+public:
+  enum Stage { kScale, kGrayscale, kTint, kNumStages };
+
+  static constexpr const char* stage_names[kNumStages] = {"scale", "grayscale", "tint"};
+
+  // check one image every "every" images at each stage; warn about any result with a PSNR below min_psnr dB
+  Verifier(int every, double min_psnr)
+      : every_(every), min_psnr_(min_psnr), memory_node_(memory_stats.node("verify")) {}
+
+  // compare the output of a node with the result of reference(), that applies the reference kernel to the same input;
+  // the reference is computed only for the images that are checked
+  template <typename Reference>
+  void check(Stage stage, Image const& output, Reference&& reference) {
+    int index = seen_[stage]++;
+    if (index % every_ != 0) {
+      return;
+    }
+    MemoryStats::Scope scope(memory_node_);
+    record(index, stage, output, reference());
+  }
+
+  void report(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << fmt::format("\nverified {} of {} images against the reference kernels\n", checked_, seen_[kScale].load());
+    out << fmt::format("{:<12} {:>12} {:>10} {:>10}\n", "kernel", "worst PSNR", "worst SSIM", "max error");
+    for (int s = 0; s < kNumStages; ++s) {
+      out << fmt::format(
+          "{:<12} {:>9.2f} dB {:>10.5f} {:>10}\n", stage_names[s], worst_[s].psnr, worst_[s].ssim, worst_[s].max_error);
+    }
+    if (failed_ > 0) {
+      out << fmt::format("{} results below {:.1f} dB\n", failed_, min_psnr_);
+    }
+  }
+
+private:
+  void record(int index, Stage stage, Image const& fast, Image const& ref) {
+    quality::Result result;
+    if (fast.width_ != ref.width_ or fast.height_ != ref.height_ or fast.channels_ != ref.channels_) {
+      result.psnr = 0.;
+      result.ssim = 0.;
+      result.max_error = 255;
+    } else {
+      result = quality::compare(fast.data_, ref.data_, fast.width_, fast.height_, fast.channels_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stage == kScale) {
+      ++checked_;
+    }
+    worst_[stage].psnr = std::min(worst_[stage].psnr, result.psnr);
+    worst_[stage].ssim = std::min(worst_[stage].ssim, result.ssim);
+    worst_[stage].max_error = std::max(worst_[stage].max_error, result.max_error);
+    if (result.psnr < min_psnr_) {
+      ++failed_;
+      std::cerr << fmt::format("image {}: {} differs from the reference, PSNR {:.2f} dB, SSIM {:.5f}, max error {}\n",
+                               index,
+                               stage_names[stage],
+                               result.psnr,
+                               result.ssim,
+                               result.max_error);
+    } else if (verbose) {
+      std::cerr << fmt::format(
+          "verify {:<10} PSNR {:6.2f} dB, SSIM {:.5f}\n", stage_names[stage], result.psnr, result.ssim);
+    }
+  }
+
+  int every_;
+  double min_psnr_;
+  int memory_node_;
+  std::array<std::atomic<int>, kNumStages> seen_ = {};
+  mutable std::mutex mutex_;
+  int checked_ = 0;
+  int failed_ = 0;
+  std::array<quality::Result, kNumStages> worst_;
+};
+
+// compose many images into a grid of columns x rows cells; each image is scaled directly into its own cell, keeping its
+// aspect ratio, so no intermediate buffers are needed and different cells can be filled concurrently
+struct ContactSheet {
+  Image canvas_;
+  int columns_ = 0;
+  int rows_ = 0;
+  int cell_width_ = 0;
+  int cell_height_ = 0;
+  // margin between the cells, in pixels
+  static constexpr int margin_ = 4;
+
+  ContactSheet(int columns, int rows, int cell_width, int cell_height, int channels = 3)
+      : canvas_(columns * cell_width, rows * cell_height, channels),
+        columns_(columns),
+        rows_(rows),
+        cell_width_(cell_width),
+        cell_height_(cell_height) {}
+
+  int size() const { return columns_ * rows_; }
+
+  // scale an image into the given cell, filled left to right and top to bottom; return false if the cell does not exist
+  bool place(Image const& img, int cell) {
+    if (cell < 0 or cell >= size()) {
+      return false;
+    }
+
+    // fit the image inside the cell, keeping its aspect ratio
+    int max_width = cell_width_ - 2 * margin_;
+    int max_height = cell_height_ - 2 * margin_;
+    int width, height;
+    if (img.width_ * max_height > img.height_ * max_width) {
+      width = max_width;
+      height = std::max(1, max_width * img.height_ / img.width_);
+    } else {
+      width = std::max(1, max_height * img.width_ / img.height_);
+      height = max_height;
+    }
+
+    // center the image inside the cell
+    int x = (cell % columns_) * cell_width_ + (cell_width_ - width) / 2;
+    int y = (cell / columns_) * cell_height_ + (cell_height_ - height) / 2;
+    scale_into(img, canvas_, x, y, width, height);
+    return true;
+  }
+};
+
+// process a stream of raw video frames (PPM or Y4M) read from the standard input with the same recipe used for the
+// images, and write the processed frames to the standard output in the same order; at most window frames are in
+// flight at any time, to bound the latency and the memory usage
+void stream(int window) {
+  using Clock = std::chrono::steady_clock;
+  using ImagePtr = std::shared_ptr<Image>;
+
+  // a frame travelling through the graph; the input image is kept alive until the frame is written out, so its buffer
+  // is reused only after the frame has left the graph
+  struct Frame {
+    std::size_t number = 0;
+    Clock::time_point start;
+    ImagePtr input;
+    ImagePtr image;
+  };
+
+  FrameReader reader(stdin);
+  FrameWriter writer(stdout, reader.info());
+
+  // pool of input buffers, reused for the following frames
+  std::vector<std::unique_ptr<Image>> buffers;
+  tbb::concurrent_queue<Image*> pool;
+
+  // latency of each frame, in ms
+  std::vector<float> latency;
+  std::size_t frames = 0;
+
+  // account the memory used by the frames to each type of node
+  const int mem_read = memory_stats.node("read");
+  const int mem_scale = memory_stats.node("scale");
+  const int mem_gray = memory_stats.node("grayscale");
+  const int mem_tint = memory_stats.node("tint");
+  const int mem_result = memory_stats.node("result");
+
+  // create a TBB flow graph
+  tbb::flow::graph graph;
+
+  tbb::flow::input_node<Frame> node_read(  // read the next frame from the standard input
+      graph,
+      [&](tbb::flow_control& control) -> Frame {
+        MemoryStats::Scope scope(mem_read);
+        int width, height;
+        if (not reader.next(width, height)) {
+          control.stop();
+          return {};
+        }
+        Image* buffer;
+        if (not pool.try_pop(buffer)) {
+          buffers.push_back(std::make_unique<Image>());
+          buffer = buffers.back().get();
+        }
+        if (buffer->width_ != width or buffer->height_ != height or buffer->channels_ != 3) {
+          *buffer = Image(width, height, 3);
+        }
+        reader.read(buffer->data_);
+
+        Frame frame;
+        frame.number = frames++;
+        frame.start = Clock::now();
+        // return the buffer to the pool when the last reference to the input image is released
+        frame.input = ImagePtr(buffer, [&pool](Image* img) { pool.push(img); });
+        return frame;
+      });
+
+  tbb::flow::limiter_node<Frame> node_limit(graph, window);
+
+  tbb::flow::function_node<Frame, Frame> node_scale(  // scale down the frame to 0.5x0.5
+      graph,
+      tbb::flow::unlimited,
+      [mem_scale](Frame frame) -> Frame {
+        MemoryStats::Scope scope(mem_scale);
+        Image const& img = *frame.input;
+        frame.image = std::make_shared<Image>(scale(img, img.width_ * 0.5, img.height_ * 0.5));
+        return frame;
+      });
+
+  tbb::flow::function_node<Frame, Frame> node_gray(  // generate a grayscale frame
+      graph,
+      tbb::flow::unlimited,
+      [mem_gray](Frame frame) -> Frame {
+        MemoryStats::Scope scope(mem_gray);
+        frame.image = std::make_shared<Image>(grayscale(*frame.image));
+        return frame;
+      });
+
+  auto make_tint = [&graph, mem_tint](int r, int g, int b) {
+    return tbb::flow::function_node<Frame, Frame>(
+        graph, tbb::flow::unlimited, [r, g, b, mem_tint](Frame frame) -> Frame {
+          MemoryStats::Scope scope(mem_tint);
+          frame.image = std::make_shared<Image>(tint(*frame.image, r, g, b));
+          return frame;
+        });
+  };
+  auto node_tint1 = make_tint(168, 56, 172);  // purple-ish
+  auto node_tint2 = make_tint(100, 143, 47);  // green-ish
+  auto node_tint3 = make_tint(255, 162, 36);  // gold-ish
+
+  // with several frames in flight, the four parts of each frame must be matched by their frame number
+  auto key = [](Frame const& frame) -> std::size_t { return frame.number; };
+  using FrameCmb = std::tuple<Frame, Frame, Frame, Frame>;
+  tbb::flow::join_node<FrameCmb, tbb::flow::key_matching<std::size_t>> node_join(graph, key, key, key, key);
+
+  tbb::flow::function_node<FrameCmb, Frame> node_result(  // combine the four parts
+      graph,
+      tbb::flow::unlimited,
+      [mem_result](FrameCmb parts) -> Frame {
+        MemoryStats::Scope scope(mem_result);
+        Frame frame = std::get<3>(parts);
+        int width = frame.image->width_;
+        int height = frame.image->height_;
+        Image out(width * 2, height * 2, frame.image->channels_);
+        write_to(*std::get<0>(parts).image, out, 0, 0);
+        write_to(*std::get<1>(parts).image, out, width, 0);
+        write_to(*std::get<2>(parts).image, out, 0, height);
+        write_to(*std::get<3>(parts).image, out, width, height);
+        frame.image = std::make_shared<Image>(std::move(out));
+        return frame;
+      });
+
+  // restore the order of the frames
+  tbb::flow::sequencer_node<Frame> node_order(graph, key);
+
+  tbb::flow::function_node<Frame, tbb::flow::continue_msg> node_write(  // write the frame to the standard output
+      graph,
+      tbb::flow::serial,
+      [&writer, &latency](Frame frame) {
+        writer.write(frame.image->data_, frame.image->width_, frame.image->height_);
+        auto finish = Clock::now();
+        latency.push_back(std::chrono::duration_cast<std::chrono::duration<float>>(finish - frame.start).count() *
+                          1000.f);
+      });
+
+  // create the graph edges
+  tbb::flow::make_edge(node_read, node_limit);
+  tbb::flow::make_edge(node_limit, node_scale);
+  tbb::flow::make_edge(node_scale, node_gray);
+  tbb::flow::make_edge(node_gray, node_tint1);
+  tbb::flow::make_edge(node_gray, node_tint2);
+  tbb::flow::make_edge(node_gray, node_tint3);
+  tbb::flow::make_edge(node_tint1, tbb::flow::input_port<0>(node_join));
+  tbb::flow::make_edge(node_tint2, tbb::flow::input_port<1>(node_join));
+  tbb::flow::make_edge(node_tint3, tbb::flow::input_port<2>(node_join));
+  tbb::flow::make_edge(node_gray, tbb::flow::input_port<3>(node_join));
+  tbb::flow::make_edge(node_join, node_result);
+  tbb::flow::make_edge(node_result, node_order);
+  tbb::flow::make_edge(node_order, node_write);
+  // each frame written out lets a new frame into the graph
+  tbb::flow::make_edge(node_write, node_limit.decrementer());
+
+  auto start = Clock::now();
+  node_read.activate();
+  graph.wait_for_all();
+  auto finish = Clock::now();
+
+  if (latency.empty()) {
+    return;
+  }
+  float seconds = std::chrono::duration_cast<std::chrono::duration<float>>(finish - start).count();
+  std::sort(latency.begin(), latency.end());
+  float p50 = latency[latency.size() / 2];
+  float p99 = latency[std::min(latency.size() - 1, latency.size() * 99 / 100)];
+  std::cerr << fmt::format("{} frames in {:.2f} s ({:.1f} fps), latency p50 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms\n",
+                           latency.size(),
+                           seconds,
+                           latency.size() / seconds,
+                           p50,
+                           p99,
+                           latency.back());
+}
+
+// process a batch of images, and write the results to files with the given prefix; render the images on the terminal
+// only if show is true
+// process the images, and count in failed those that could not be read or written; return EXIT_FAILURE if the settings
+// are invalid, without processing any image
+int run(std::vector<std::string> const& files, std::string const& prefix, bool show, std::atomic<int>& failed) {
   const char* verbose_env = std::getenv("VERBOSE");
   if (verbose_env != nullptr and std::strlen(verbose_env) != 0) {
     verbose = true;
   }
 
-  std::vector<std::string> files;
-  if (argc == 1) {
-    // no arguments, use a single default image
-    files = {"image.png"s};
-  } else {
-    files.reserve(argc - 1);
-    for (int i = 1; i < argc; ++i) {
-      files.emplace_back(argv[i]);
+  const char* memory_env = std::getenv("MEMORY_STATS");
+  if (memory_env != nullptr and std::strlen(memory_env) != 0) {
+    memory_stats.enable();
+  }
+
+  const char* perf_env = std::getenv("PERF_COUNTERS");
+  if (perf_env != nullptr and std::strlen(perf_env) != 0) {
+    perf_counters.enable();
+  }
+
+  // optional cache of decoded and scaled images, bounded to IMAGE_CACHE_SIZE MB (1 GB by default)
+  const char* cache_env = std::getenv("IMAGE_CACHE");
+  if (cache_env != nullptr and std::strlen(cache_env) != 0) {
+    std::uint64_t cache_size = 1024;
+    const char* cache_size_env = std::getenv("IMAGE_CACHE_SIZE");
+    if (cache_size_env != nullptr and std::strlen(cache_size_env) != 0) {
+      cache_size = std::strtoull(cache_size_env, nullptr, 10);
+    }
+    image_cache = std::make_unique<ImageCache>(cache_env, cache_size * 1024 * 1024);
+  }
+
+  // optionally rotate (clockwise, by a multiple of 90 degrees) and mirror ("h", "v" or "hv") the final images
+  int rotation = 0;
+  const char* rotate_env = std::getenv("ROTATE");
+  if (rotate_env != nullptr and std::strlen(rotate_env) != 0) {
+    char* end;
+    rotation = static_cast<int>(std::strtol(rotate_env, &end, 10));
+    if (*end != '\0' or rotation % 90 != 0) {
+      std::cerr << "Invalid rotation " << rotate_env << ", it must be a multiple of 90 degrees\n";
+      return EXIT_FAILURE;
+    }
+  }
+  bool flip_h = false;
+  bool flip_v = false;
+  const char* flip_env = std::getenv("FLIP");
+  if (flip_env != nullptr) {
+    if (std::strspn(flip_env, "hv") != std::strlen(flip_env)) {
+      std::cerr << "Invalid flip " << flip_env << ", it must be \"h\", \"v\" or \"hv\"\n";
+      return EXIT_FAILURE;
+    }
+    flip_h = std::strchr(flip_env, 'h') != nullptr;
+    flip_v = std::strchr(flip_env, 'v') != nullptr;
+  }
+
+  // a single "-" argument reads a stream of raw video frames from the standard input
+  if (files.size() == 1 and files[0] == "-") {
+    int window = 4;
+    const char* window_env = std::getenv("STREAM_WINDOW");
+    if (window_env != nullptr and std::strlen(window_env) != 0) {
+      window = std::max(1, std::atoi(window_env));
     }
+    stream(window);
+    perf_counters.report(std::cerr);
+    memory_stats.report(std::cerr);
+    return 0;
   }
 
   int rows = 80;
@@ -387,20 +1155,155 @@ int main(int argc, const char* argv[]) {
   }
 #endif
 
+  // create a TBB flow graph
+  tbb::flow::graph graph;
+
+  // optionally compose all the images into a single contact sheet of COLUMNSxROWS cells, instead of processing them
+  // one by one; if the number of rows is 0, use as many as needed to fit all the images
+  const char* sheet_env = std::getenv("CONTACT_SHEET");
+  if (sheet_env != nullptr and std::strlen(sheet_env) != 0) {
+    int sheet_columns = 0;
+    int sheet_rows = 0;
+    int length = 0;
+    if (std::sscanf(sheet_env, "%dx%d%n", &sheet_columns, &sheet_rows, &length) != 2 or sheet_env[length] != '\0' or
+        sheet_columns <= 0 or sheet_rows < 0) {
+      std::cerr << "Invalid contact sheet size " << sheet_env
+                << ", it must be COLUMNSxROWS, with ROWS = 0 to fit all the images\n";
+      return EXIT_FAILURE;
+    }
+    if (sheet_rows == 0) {
+      sheet_rows = (static_cast<int>(files.size()) + sheet_columns - 1) / sheet_columns;
+    }
+
+    // size of each cell, in pixels, including a margin on each side
+    int cell_width = 160;
+    int cell_height = 120;
+    const char* cell_env = std::getenv("CONTACT_SHEET_CELL");
+    if (cell_env != nullptr and std::strlen(cell_env) != 0) {
+      if (std::sscanf(cell_env, "%dx%d%n", &cell_width, &cell_height, &length) != 2 or cell_env[length] != '\0' or
+          cell_width <= 2 * ContactSheet::margin_ or cell_height <= 2 * ContactSheet::margin_) {
+        std::cerr << "Invalid contact sheet cell size " << cell_env << ", it must be WIDTHxHEIGHT, larger than "
+                  << 2 * ContactSheet::margin_ << "x" << 2 * ContactSheet::margin_ << " pixels\n";
+        return EXIT_FAILURE;
+      }
+    }
+
+    // the size of the canvas, in bytes, must fit in an int
+    if (static_cast<double>(sheet_columns) * cell_width * sheet_rows * cell_height * 3 >
+        std::numeric_limits<int>::max()) {
+      std::cerr << fmt::format("The contact sheet of {}x{} cells of {}x{} pixels is too large\n",
+                               sheet_columns,
+                               sheet_rows,
+                               cell_width,
+                               cell_height);
+      return EXIT_FAILURE;
+    }
+
+    ContactSheet sheet(sheet_columns, sheet_rows, cell_width, cell_height);
+    if (static_cast<int>(files.size()) > sheet.size()) {
+      std::cerr << "Only the first " << sheet.size() << " images fit in the contact sheet\n";
+    }
+
+    // account the memory used by the images read into the contact sheet
+    const int mem_sheet = memory_stats.node("sheet");
+
+    tbb::flow::function_node<int, tbb::flow::continue_msg> node_sheet(  // read an image and scale it into its cell
+        graph,
+        tbb::flow::unlimited,
+        [&files, &sheet, &failed, mem_sheet](int index) {
+          MemoryStats::Scope scope(mem_sheet);
+          // an image that cannot be read leaves its cell empty
+          try {
+            Image img(files[index]);
+            sheet.place(img, index);
+          } catch (std::runtime_error const& e) {
+            std::cerr << e.what() << '\n';
+            ++failed;
+          }
+        });
+
+    // send data through the graph
+    for (int i = 0; i < std::min(static_cast<int>(files.size()), sheet.size()); ++i) {
+      node_sheet.try_put(i);
+    }
+
+    // wait for all operation to complete
+    graph.wait_for_all();
+
+    if (show) {
+      sheet.canvas_.show(columns, rows);
+    }
+    sheet.canvas_.write(prefix + "contact_sheet.jpg");
+
+    // report the hardware performance counters, if enabled
+    perf_counters.report(std::cerr);
+
+    // report the memory used by the images, and any image still alive
+    memory_stats.report(std::cerr);
+
+    return 0;
+  }
+
   // count how many images have been processed
   std::atomic<int> counter = 0;
 
-  // create a TBB flow graph
-  tbb::flow::graph graph;
+  // format of the output images: "jpg", "png", or "raw" to pass them to another job without encoding them
+  std::string format = "jpg";
+  const char* format_env = std::getenv("OUTPUT_FORMAT");
+  if (format_env != nullptr and std::strlen(format_env) != 0) {
+    format = format_env;
+  }
+
+  // optionally verify the kernels against the reference implementations on one image every VERIFY images, warning
+  // about any result with a PSNR below VERIFY_PSNR dB (40 by default)
+  std::unique_ptr<Verifier> verifier;
+  const char* verify_env = std::getenv("VERIFY");
+  if (verify_env != nullptr and std::strlen(verify_env) != 0) {
+    double min_psnr = 40.;
+    const char* psnr_env = std::getenv("VERIFY_PSNR");
+    if (psnr_env != nullptr and std::strlen(psnr_env) != 0) {
+      min_psnr = std::atof(psnr_env);
+    }
+    verifier = std::make_unique<Verifier>(std::max(1, std::atoi(verify_env)), min_psnr);
+  }
+
+  // the first operation scales the images down to 0.5x0.5, so JPEG images can be decoded directly at 1/2 resolution;
+  // set FULL_DECODE to always decode them at full resolution
+  int reduction = reduction_for(0.5f);
+  const char* full_decode_env = std::getenv("FULL_DECODE");
+  if (full_decode_env != nullptr and std::strlen(full_decode_env) != 0) {
+    reduction = 1;
+  }
+
+  // account the memory used by the images to each type of node
+  const int mem_open = memory_stats.node("open");
+  const int mem_scale = memory_stats.node("scale");
+  const int mem_gray = memory_stats.node("grayscale");
+  const int mem_tint = memory_stats.node("tint");
+  const int mem_result = memory_stats.node("result");
+  const int mem_orient = memory_stats.node("orient");
+  const int mem_write = memory_stats.node("write");
 
   // create the graph nodes
   using ImagePtr = std::shared_ptr<Image>;
   using ImageCmb = std::tuple<ImagePtr, ImagePtr, ImagePtr, ImagePtr>;
 
-  tbb::flow::function_node<std::string, ImagePtr> node_open(  // read the image from a file
+  using OpenNode = tbb::flow::multifunction_node<std::string, std::tuple<ImagePtr>>;
+  OpenNode node_open(  // read the image from a file; an image that cannot be read is reported and skipped
       graph,
       tbb::flow::unlimited,
-      [](std::string filename) -> ImagePtr { return std::make_shared<Image>(filename); });
+      [reduction, mem_open, &failed](std::string filename, OpenNode::output_ports_type& ports) {
+        ImagePtr img;
+        try {
+          MemoryStats::Scope scope(mem_open);
+          img = std::make_shared<Image>(open_cached(filename, reduction));
+        } catch (std::runtime_error const& e) {
+          std::cerr << e.what() << '\n';
+          ++failed;
+          return;
+        }
+        std::get<0>(ports).try_put(img);
+      });
 
   tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_show(  // render the image on the terminal
       graph,
@@ -410,36 +1313,73 @@ int main(int argc, const char* argv[]) {
   tbb::flow::function_node<ImagePtr, ImagePtr> node_scale(  // scale down the image to 0.5x0.5
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr {
-        return std::make_shared<Image>(scale(*img, img->width_ * 0.5, img->height_ * 0.5));
+      [mem_scale, verify = verifier.get()](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_scale);
+        // the target size is relative to the full resolution image, that may have been decoded at a reduced resolution
+        int width = img->width_ * img->reduction_ * 0.5;
+        int height = img->height_ * img->reduction_ * 0.5;
+        auto out = std::make_shared<Image>(scale_cached(*img, width, height));
+        if (verify) {
+          verify->check(Verifier::kScale, *out, [&] { return reference::scale(*img, width, height); });
+        }
+        return out;
       });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_gray(  // generate a grayscale image
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(grayscale(*img)); });
+      [mem_gray, verify = verifier.get()](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_gray);
+        auto out = std::make_shared<Image>(grayscale(*img));
+        if (verify) {
+          verify->check(Verifier::kGrayscale, *out, [&] { return reference::grayscale(*img); });
+        }
+        return out;
+      });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_tint1(  // apply a purple-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 168, 56, 172)); });
+      [mem_tint, verify = verifier.get()](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_tint);
+        auto out = std::make_shared<Image>(tint(*img, 168, 56, 172));
+        if (verify) {
+          verify->check(Verifier::kTint, *out, [&] { return reference::tint(*img, 168, 56, 172); });
+        }
+        return out;
+      });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_tint2(  // apply a green-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 100, 143, 47)); });
+      [mem_tint, verify = verifier.get()](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_tint);
+        auto out = std::make_shared<Image>(tint(*img, 100, 143, 47));
+        if (verify) {
+          verify->check(Verifier::kTint, *out, [&] { return reference::tint(*img, 100, 143, 47); });
+        }
+        return out;
+      });
 
   tbb::flow::function_node<ImagePtr, ImagePtr> node_tint3(  // apply a gold-ish tint
       graph,
       tbb::flow::unlimited,
-      [](ImagePtr img) -> ImagePtr { return std::make_shared<Image>(tint(*img, 255, 162, 36)); });
+      [mem_tint, verify = verifier.get()](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_tint);
+        auto out = std::make_shared<Image>(tint(*img, 255, 162, 36));
+        if (verify) {
+          verify->check(Verifier::kTint, *out, [&] { return reference::tint(*img, 255, 162, 36); });
+        }
+        return out;
+      });
 
   tbb::flow::join_node<ImageCmb, tbb::flow::queueing> node_join(graph);
 
   tbb::flow::function_node<ImageCmb, ImagePtr> node_result(  // combine the images
       graph,
       tbb::flow::unlimited,
-      [](ImageCmb images) -> ImagePtr {
+      [mem_result](ImageCmb images) -> ImagePtr {
+        MemoryStats::Scope scope(mem_result);
         int width = std::get<0>(images)->width_;
         int height = std::get<0>(images)->height_;
         int channels = std::get<0>(images)->channels_;
@@ -451,17 +1391,39 @@ int main(int argc, const char* argv[]) {
         return std::make_shared<Image>(std::move(out));
       });
 
+  tbb::flow::function_node<ImagePtr, ImagePtr> node_orient(  // rotate and mirror the combined image
+      graph,
+      tbb::flow::unlimited,
+      [rotation, flip_h, flip_v, mem_orient](ImagePtr img) -> ImagePtr {
+        MemoryStats::Scope scope(mem_orient);
+        if (rotation % 360 != 0) {
+          img = std::make_shared<Image>(rotate(*img, rotation));
+        }
+        if (flip_h or flip_v) {
+          img = std::make_shared<Image>(flip(*img, flip_h, flip_v));
+        }
+        return img;
+      });
+
   tbb::flow::function_node<ImagePtr, tbb::flow::continue_msg> node_write(  // write the image to a file
       graph,
       tbb::flow::unlimited,
-      [&counter](ImagePtr img) {
-        std::string filename = fmt::format("out{:02d}.jpg", counter++);
-        img->write(filename);
+      [&counter, &format, &prefix, &failed, mem_write](ImagePtr img) {
+        MemoryStats::Scope scope(mem_write);
+        std::string filename = fmt::format("{}out{:02d}.{}", prefix, counter++, format);
+        try {
+          img->write(filename);
+        } catch (std::runtime_error const& e) {
+          std::cerr << e.what() << '\n';
+          ++failed;
+        }
       });
 
   // create the graph edges
-  tbb::flow::make_edge(node_open, node_show);
-  tbb::flow::make_edge(node_open, node_scale);
+  if (show) {
+    tbb::flow::make_edge(tbb::flow::output_port<0>(node_open), node_show);
+  }
+  tbb::flow::make_edge(tbb::flow::output_port<0>(node_open), node_scale);
   tbb::flow::make_edge(node_scale, node_gray);
   tbb::flow::make_edge(node_gray, node_tint1);
   tbb::flow::make_edge(node_gray, node_tint2);
@@ -471,8 +1433,18 @@ int main(int argc, const char* argv[]) {
   tbb::flow::make_edge(node_tint3, tbb::flow::input_port<2>(node_join));
   tbb::flow::make_edge(node_gray, tbb::flow::input_port<3>(node_join));
   tbb::flow::make_edge(node_join, node_result);
-  tbb::flow::make_edge(node_result, node_show);
-  tbb::flow::make_edge(node_result, node_write);
+  if (rotation % 360 != 0 or flip_h or flip_v) {
+    tbb::flow::make_edge(node_result, node_orient);
+    if (show) {
+      tbb::flow::make_edge(node_orient, node_show);
+    }
+    tbb::flow::make_edge(node_orient, node_write);
+  } else {
+    if (show) {
+      tbb::flow::make_edge(node_result, node_show);
+    }
+    tbb::flow::make_edge(node_result, node_write);
+  }
 
   // send data through the graph
   for (auto const& filename : files) {
@@ -482,5 +1454,112 @@ int main(int argc, const char* argv[]) {
   // wait for all operation to complete
   graph.wait_for_all();
 
+  // report the hardware performance counters, if enabled
+  perf_counters.report(std::cerr);
+
+  if (image_cache and verbose) {
+    image_cache->report(std::cerr);
+  }
+
+  if (verifier) {
+    verifier->report(std::cerr);
+  }
+
+  // report the memory used by the images, and any image still alive
+  memory_stats.report(std::cerr);
+
   return 0;
 }
+
+#ifdef USE_MPI
+// distribute the images across the ranks of an MPI job; each rank processes its share of the images with its own TBB
+// flow graph, using THREADS_PER_RANK threads (by default, the available cores divided by the ranks on the same node)
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  std::vector<std::string> files;
+  if (argc == 1) {
+    // no arguments, use a single default image
+    files = {"image.png"s};
+  } else {
+    files.assign(argv + 1, argv + argc);
+  }
+  if (std::find(files.begin(), files.end(), "-"s) != files.end()) {
+    if (rank == 0) {
+      std::cerr << "Streaming from the standard input is not supported with MPI\n";
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+
+  // the files assigned to this rank
+  auto shards = mpi_driver::shard(files, size);
+  std::vector<std::string> local;
+  mpi_driver::Stats stats;
+  for (int index : shards[rank]) {
+    local.push_back(files[index]);
+    std::error_code error;
+    auto bytes = std::filesystem::file_size(files[index], error);
+    if (not error) {
+      stats.megabytes += bytes / 1e6;
+    }
+  }
+  stats.images = static_cast<int>(local.size());
+
+  int threads = std::max(1, tbb::info::default_concurrency() / mpi_driver::local_ranks());
+  const char* threads_env = std::getenv("THREADS_PER_RANK");
+  if (threads_env != nullptr and std::strlen(threads_env) != 0) {
+    threads = std::max(1, std::atoi(threads_env));
+  }
+  stats.threads = threads;
+  mpi_driver::set_host(stats);
+
+  // start all the ranks together, so that their timings are comparable
+  MPI_Barrier(MPI_COMM_WORLD);
+  auto start = std::chrono::steady_clock::now();
+  int status = 0;
+  if (not local.empty()) {
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+    // the images that cannot be read or written are skipped and counted by run(); invalid settings stop it before it
+    // processes any image, and any other error cancels the whole flow graph of this rank: in both cases count all its
+    // images as failed, and keep going, so that every rank still takes part in the collection of the statistics
+    std::atomic<int> failed = 0;
+    try {
+      status = run(local, fmt::format("rank{:03d}_", rank), false, failed);
+      stats.failed = status == EXIT_SUCCESS ? failed.load() : stats.images;
+    } catch (std::exception const& e) {
+      std::cerr << fmt::format("rank {}: {}\n", rank, e.what());
+      status = EXIT_FAILURE;
+      stats.failed = stats.images;
+    }
+  }
+  auto finish = std::chrono::steady_clock::now();
+  stats.seconds = std::chrono::duration_cast<std::chrono::duration<double>>(finish - start).count();
+
+  if (mpi_driver::report(stats, std::cout) > 0 or stats.failed > 0) {
+    status = EXIT_FAILURE;
+  }
+
+  MPI_Finalize();
+  return status;
+}
+#else
+int main(int argc, const char* argv[]) {
+  std::vector<std::string> files;
+  if (argc == 1) {
+    // no arguments, use a single default image
+    files = {"image.png"s};
+  } else {
+    files.reserve(argc - 1);
+    for (int i = 1; i < argc; ++i) {
+      files.emplace_back(argv[i]);
+    }
+  }
+
+  std::atomic<int> failed = 0;
+  int status = run(files, "", true, failed);
+  return failed > 0 ? EXIT_FAILURE : status;
+}
+#endif  // USE_MPI
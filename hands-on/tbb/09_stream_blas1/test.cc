@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <execution>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "lane_sum.h"
+#include "measure.h"
+#include "thread_sweep.h"
+
+// A STREAM-like suite of BLAS-1 kernels.
+//
+// Each kernel streams through arrays much larger than the caches, so its speed is limited by the memory bandwidth
+// rather than by the arithmetic. The bandwidth achieved by each kernel is computed from the bytes it reads and writes,
+// without counting the extra reads caused by the write-allocate policy of the caches, as STREAM does, and compared with
+// the peak bandwidth of the machine: either a known value given with PEAK_BANDWIDTH (in GB/s), or the best bandwidth
+// measured at startup by the TBB implementation of the STREAM kernels (copy, scale, add and triad) and of a read-only
+// parallel sum.
+
+template <typename T>
+void axpy(T a, T x, T y, T& z) {
+  z = a * x + y;
+}
+
+// tag to select the TBB implementation of the kernels, instead of the standard algorithms
+struct tbb_policy {};
+inline constexpr tbb_policy tbb_parallel;
+
+// The TBB kernels use a static partitioner, so that each thread always processes the same part of the arrays, the same
+// part it wrote to when the arrays were first touched.
+
+// z[i] = op(x[i])
+template <typename T>
+void unary_kernel(auto policy, std::span<T const> x, std::span<T> z, auto op) {
+  std::transform(policy, x.begin(), x.end(), z.begin(), op);
+}
+
+template <typename T>
+void unary_kernel(tbb_policy, std::span<T const> x, std::span<T> z, auto op) {
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, z.size()),
+      [&](tbb::blocked_range<std::size_t> const& range) {
+        for (std::size_t i = range.begin(); i < range.end(); ++i) {
+          z[i] = op(x[i]);
+        }
+      },
+      tbb::static_partitioner());
+}
+
+// z[i] = op(x[i], y[i])
+template <typename T>
+void binary_kernel(auto policy, std::span<T const> x, std::span<T const> y, std::span<T> z, auto op) {
+  std::transform(policy, x.begin(), x.end(), y.begin(), z.begin(), op);
+}
+
+template <typename T>
+void binary_kernel(tbb_policy, std::span<T const> x, std::span<T const> y, std::span<T> z, auto op) {
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, z.size()),
+      [&](tbb::blocked_range<std::size_t> const& range) {
+        for (std::size_t i = range.begin(); i < range.end(); ++i) {
+          z[i] = op(x[i], y[i]);
+        }
+      },
+      tbb::static_partitioner());
+}
+
+// sum of op(x[i], y[i])
+template <typename T>
+T reduction_kernel(auto policy, std::span<T const> x, std::span<T const> y, auto op) {
+  return std::transform_reduce(policy, x.begin(), x.end(), y.begin(), T{0}, std::plus<>(), op);
+}
+
+template <typename T>
+T reduction_kernel(tbb_policy, std::span<T const> x, std::span<T const> y, auto op) {
+  return tbb::parallel_reduce(
+      tbb::blocked_range<std::size_t>(0, x.size()),
+      T{0},
+      [&](tbb::blocked_range<std::size_t> const& range, T sum) -> T {
+        return sum + lane_sum<T>(range.begin(), range.end(), [&](std::size_t i) { return op(x[i], y[i]); });
+      },
+      std::plus<>(),
+      tbb::static_partitioner());
+}
+
+// the arrays used by the kernels
+template <typename T>
+struct Arrays {
+  Arrays(std::size_t size)
+      : size(size),
+        a_(std::make_unique_for_overwrite<T[]>(size)),
+        b_(std::make_unique_for_overwrite<T[]>(size)),
+        c_(std::make_unique_for_overwrite<T[]>(size)),
+        a(a_.get(), size),
+        b(b_.get(), size),
+        c(c_.get(), size) {
+    // first touch the arrays in parallel, with the same partitioning as the TBB kernels
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>(0, size),
+        [&](tbb::blocked_range<std::size_t> const& range) {
+          for (std::size_t i = range.begin(); i < range.end(); ++i) {
+            a[i] = 1;
+            b[i] = 2;
+            c[i] = 0;
+          }
+        },
+        tbb::static_partitioner());
+  }
+
+  std::size_t size;
+  std::unique_ptr<T[]> a_, b_, c_;
+  std::span<T> a, b, c;
+};
+
+// a kernel of the suite
+template <typename T>
+struct Kernel {
+  std::string name;
+  // number of arrays read and written by the kernel
+  int arrays;
+  std::function<void()> run;
+  // the kernel is one of the STREAM kernels, and its bandwidth is comparable with theirs
+  bool stream = false;
+};
+
+// bandwidth of a kernel that took the given time, in GB/s
+template <typename T>
+double bandwidth(Kernel<T> const& kernel, std::size_t size, double ms) {
+  return static_cast<double>(kernel.arrays) * size * sizeof(T) / (ms * 1.e6);
+}
+
+template <typename T>
+std::vector<Kernel<T>> kernels(auto policy, Arrays<T>& arrays) {
+  constexpr int chain = 4;
+  const T scalar = 3;
+  std::span<T> a = arrays.a, b = arrays.b, c = arrays.c;
+  std::span<T const> ca = a, cb = b, cc = c;
+  // the results of the reductions are stored here, so that the compiler cannot remove them
+  [[maybe_unused]] static volatile T result;
+
+  return {
+      {"copy", 2, [=] { unary_kernel<T>(policy, ca, c, [](T x) { return x; }); }, true},
+      {"scale", 2, [=] { unary_kernel<T>(policy, cc, b, [=](T x) { return scalar * x; }); }, true},
+      {"add", 3, [=] { binary_kernel<T>(policy, ca, cb, c, [](T x, T y) { return x + y; }); }, true},
+      {"triad", 3, [=] { binary_kernel<T>(policy, cb, cc, a, [=](T x, T y) { return x + scalar * y; }); }, true},
+      {"dot", 2, [=] { result = reduction_kernel<T>(policy, ca, cb, [](T x, T y) { return x * y; }); }},
+      {"nrm2", 1, [=] { result = std::sqrt(reduction_kernel<T>(policy, ca, ca, [](T x, T) { return x * x; })); }},
+      // a sequence of axpy operations, each one reading the result of the previous one; the result is updated in place,
+      // so its cache lines are already read before they are written, and the kernel does not pay for the write-allocate
+      // reads of the STREAM kernels: its bandwidth is not directly comparable with theirs
+      {"axpy chain", 3 * chain, [=] {
+         for (int i = 0; i < chain; ++i) {
+           binary_kernel<T>(policy, ca, cc, c, [=](T x, T y) {
+             T z;
+             axpy(T{1} / chain, x, y, z);
+             return z;
+           });
+         }
+       }}};
+}
+
+// best bandwidth of the TBB implementation of the STREAM kernels and of a read-only parallel sum, in GB/s; a single
+// kernel would under-estimate the peak, as different kernels reach their best bandwidth on different machines
+template <typename T>
+double measure_peak(Arrays<T>& arrays, std::size_t times) {
+  std::vector<Kernel<T>> candidates;
+  for (auto& kernel : kernels(tbb_parallel, arrays)) {
+    if (kernel.stream) {
+      candidates.push_back(std::move(kernel));
+    }
+  }
+  std::span<T const> a = arrays.a;
+  [[maybe_unused]] static volatile T result;
+  candidates.push_back({"sum", 1, [=] { result = reduction_kernel<T>(tbb_parallel, a, a, [](T x, T) { return x; }); }});
+
+  double best = 0.;
+  for (auto const& kernel : candidates) {
+    // skip the first run, to warm up the thread pool
+    kernel.run();
+    for (std::size_t i = 0; i < times; ++i) {
+      best = std::max(best, bandwidth(kernel, arrays.size, measure(kernel.run)));
+    }
+  }
+  return best;
+}
+
+template <typename T>
+void run_suite(
+    std::string const& name, auto policy, Arrays<T>& arrays, std::size_t times, double peak, ThreadSweep& sweep) {
+  std::cout << name << '\n';
+  std::cout << "  kernel        best GB/s   % of peak   avg ms   min ms   max ms\n";
+  for (auto const& kernel : kernels(policy, arrays)) {
+    // skip the first run, to warm up the thread pool
+    kernel.run();
+    std::vector<double> times_ms;
+    for (std::size_t i = 0; i < times; ++i) {
+      times_ms.push_back(measure(kernel.run));
+    }
+    double min = *std::ranges::min_element(times_ms);
+    double max = *std::ranges::max_element(times_ms);
+    double avg = std::accumulate(times_ms.begin(), times_ms.end(), 0.) / times;
+    double gbs = bandwidth(kernel, arrays.size, min);
+    std::cout << "  " << std::left << std::setw(12) << kernel.name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(11) << gbs << std::setw(11) << 100. * gbs / peak << "%" << std::setw(9) << avg
+              << std::setw(9) << min << std::setw(9) << max << '\n';
+    sweep.record(kernel.name + ", " + name, min);
+    emit("stream", times_ms, "size", arrays.size, "kernel", kernel.name, "implementation", name);
+  }
+  std::cout << '\n';
+}
+
+int main() {
+  // the arrays should be much larger than the last level cache
+  std::size_t size = 1 << 25;
+  const char* size_env = std::getenv("STREAM_SIZE");
+  if (size_env != nullptr and std::strlen(size_env) != 0) {
+    size = std::stoull(size_env);
+  }
+  std::size_t times = 10;
+  const char* times_env = std::getenv("STREAM_REPEATS");
+  if (times_env != nullptr and std::strlen(times_env) != 0) {
+    times = std::max(1, std::atoi(times_env));
+  }
+
+  Arrays<double> arrays(size);
+  std::cout << "array size: " << size << " elements, " << size * sizeof(double) / 1048576 << " MB per array\n";
+
+  double peak;
+  const char* peak_env = std::getenv("PEAK_BANDWIDTH");
+  if (peak_env != nullptr and std::strlen(peak_env) != 0) {
+    peak = std::stod(peak_env);
+    std::cout << "peak memory bandwidth: " << std::fixed << std::setprecision(1) << peak << " GB/s\n\n";
+  } else {
+    peak = measure_peak(arrays, times);
+    std::cout << "peak memory bandwidth: " << std::fixed << std::setprecision(1) << peak
+              << " GB/s (best of the STREAM kernels and of a read-only parallel sum)\n\n";
+  }
+
+  // optionally, repeat the measurements with 1, 2, 4, ... threads
+  ThreadSweep sweep;
+  sweep.run([&] {
+    run_suite("std::execution::seq", std::execution::seq, arrays, times, peak, sweep);
+    run_suite("std::execution::unseq", std::execution::unseq, arrays, times, peak, sweep);
+    run_suite("std::execution::par", std::execution::par, arrays, times, peak, sweep);
+    run_suite("std::execution::par_unseq", std::execution::par_unseq, arrays, times, peak, sweep);
+    run_suite("TBB parallel_for", tbb_parallel, arrays, times, peak, sweep);
+  });
+  sweep.report(std::cout);
+}
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "backend.h"
+#include "measure.h"
+#include "philox.h"
+
+// The axpy and sort kernels, written once and run with each of the parallel backends.
+
+template <typename T>
+void axpy(T a, T x, T y, T& z) {
+  z = a * x + y;
+}
+
+template <typename T>
+void parallel_axpy(backend::Backend& backend, T a, std::vector<T> const& x, std::vector<T> const& y, std::span<T> z) {
+  backend.parallel_for(x.size(), [&](std::size_t begin, std::size_t end) {
+    T const* __restrict__ xp = x.data();
+    T const* __restrict__ yp = y.data();
+    T* __restrict__ zp = z.data();
+    for (std::size_t i = begin; i < end; ++i) {
+      axpy(a, xp[i], yp[i], zp[i]);
+    }
+  });
+}
+
+// merge sort: the input is split in a power of two number of runs that are sorted in parallel, then pairs of adjacent
+// runs are merged in parallel, until a single run is left; the last merges have little parallelism
+template <typename T>
+void parallel_sort(backend::Backend& backend, std::vector<T>& v) {
+  constexpr std::size_t min_run_size = 1 << 14;
+  const std::size_t size = v.size();
+  const std::size_t runs = std::bit_floor(std::clamp<std::size_t>(size / min_run_size, 1, 4 * backend.concurrency()));
+  auto bound = [&](std::size_t run) { return size * run / runs; };
+
+  backend.parallel_for(
+      runs,
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t run = begin; run < end; ++run) {
+          std::sort(v.begin() + bound(run), v.begin() + bound(run + 1));
+        }
+      },
+      1);
+
+  std::vector<T> buffer(size);
+  std::vector<T>* src = &v;
+  std::vector<T>* dst = &buffer;
+  for (std::size_t width = 1; width < runs; width *= 2) {
+    backend.parallel_for(
+        runs / (2 * width),
+        [&](std::size_t begin, std::size_t end) {
+          for (std::size_t pair = begin; pair < end; ++pair) {
+            auto first = src->begin() + bound(2 * pair * width);
+            auto middle = src->begin() + bound((2 * pair + 1) * width);
+            auto last = src->begin() + bound((2 * pair + 2) * width);
+            std::merge(first, middle, middle, last, dst->begin() + bound(2 * pair * width));
+          }
+        },
+        1);
+    std::swap(src, dst);
+  }
+  if (src != &v) {
+    v.swap(buffer);
+  }
+}
+
+struct Result {
+  std::string backend;
+  int threads;
+  float axpy_ms;
+  float sort_ms;
+};
+
+// append the times of a kernel run by a backend to the file given by BENCH_OUTPUT, if any; the number of threads is
+// the concurrency of the backend, that is not limited by TBB for the other backends
+void emit(const char* kernel, Result const& result, std::size_t size, std::vector<double> const& times) {
+  bench_emit("parallel_backends",
+             parameter_list("size", size, "kernel", kernel, "backend", result.backend).c_str(),
+             "ms",
+             bench_statistics(times.data(), times.size()),
+             result.threads);
+}
+
+int main() {
+  const std::size_t axpy_size = 100'000'000;
+  const std::size_t sort_size = 10'000'000;
+  const std::size_t times = 10;
+
+  // comma-separated list of the backends to run, e.g. BACKENDS=tbb,openmp; by default, all the available ones
+  std::vector<std::string> names = backend::available();
+  const char* backends_env = std::getenv("BACKENDS");
+  if (backends_env != nullptr and std::strlen(backends_env) != 0) {
+    names.clear();
+    std::istringstream stream(backends_env);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+      names.push_back(name);
+    }
+  }
+
+  std::mt19937 gen{std::random_device{}()};
+  std::uniform_real_distribution<float> dis{-std::numbers::pi, std::numbers::pi};
+  float a = dis(gen);
+  std::vector<float> x(axpy_size);
+  philox::fill_uniform(x, dis.a(), dis.b(), gen());
+  std::vector<float> y(axpy_size);
+  philox::fill_uniform(y, dis.a(), dis.b(), gen());
+  std::vector<std::uint64_t> keys(sort_size);
+  philox::fill_bits(keys, gen());
+  std::vector<std::uint64_t> sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  std::vector<Result> results;
+  for (auto const& name : names) {
+    auto backend = backend::make_backend(name);
+    if (not backend) {
+      std::cout << name << ": not available in this build\n\n";
+      continue;
+    }
+    const float max = std::numeric_limits<float>::max();
+    Result result{backend->name(), backend->concurrency(), max, max};
+
+    // the output buffer is first touched by the same backend as the kernel
+    auto buffer = std::make_unique_for_overwrite<float[]>(axpy_size);
+    std::span<float> z(buffer.get(), axpy_size);
+    parallel_axpy(*backend, 0.f, x, y, z);
+
+    std::cout << result.backend << " axpy\n";
+    std::vector<double> times_ms;
+    for (std::size_t i = 0; i < times; ++i) {
+      float ms = measure([&] { parallel_axpy(*backend, a, x, y, z); });
+      std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms\n";
+      result.axpy_ms = std::min(result.axpy_ms, ms);
+      times_ms.push_back(ms);
+    }
+    std::cout << '\n';
+    emit("axpy", result, axpy_size, times_ms);
+
+    std::cout << result.backend << " sort\n";
+    times_ms.clear();
+    for (std::size_t i = 0; i < times; ++i) {
+      std::vector<std::uint64_t> v = keys;
+      float ms = measure([&] { parallel_sort(*backend, v); });
+      std::cout << std::fixed << std::setprecision(1) << std::setw(6) << ms << " ms\n";
+      if (v != sorted) {
+        std::cerr << result.backend << ": the sort returned a wrong result\n";
+        return EXIT_FAILURE;
+      }
+      result.sort_ms = std::min(result.sort_ms, ms);
+      times_ms.push_back(ms);
+    }
+    std::cout << '\n';
+    emit("sort", result, sort_size, times_ms);
+
+    results.push_back(result);
+  }
+
+  // best time of each kernel with each backend
+  std::cout << "backend            threads   axpy (ms)   axpy (GB/s)   sort (ms)\n";
+  for (auto const& result : results) {
+    float gbs = 3.f * axpy_size * sizeof(float) / (result.axpy_ms * 1.e6f);
+    std::cout << std::left << std::setw(18) << result.backend << std::right << std::setw(8) << result.threads
+              << std::fixed << std::setprecision(1) << std::setw(12) << result.axpy_ms << std::setw(14) << gbs
+              << std::setw(12) << result.sort_ms << '\n';
+  }
+}
@@ -0,0 +1,247 @@
+#ifndef scan_h
+#define scan_h
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <execution>
+#include <functional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "lane_sum.h"
+
+// Parallel prefix sums (scans) and stream compaction.
+//
+// Each kernel has three implementations, selected by the policy argument:
+//   - a standard execution policy uses the algorithms of the standard library, std::inclusive_scan,
+//     std::exclusive_scan and std::copy_if;
+//   - tbb_parallel uses tbb::parallel_scan, that may scan parts of the input twice: once only to compute their sum, and
+//     once more to write the result;
+//   - blocked_parallel uses a hand-written two-pass scan: the first pass computes the sum of each block of the input in
+//     parallel, a short serial scan of the block sums gives the offset of each block, and the second pass scans each
+//     block in parallel, starting from its offset. Both passes stream through the input, and the scan within each
+//     block is vectorised explicitly, with the GCC and clang vector extensions.
+
+// tag to select the tbb::parallel_scan implementation of the kernels
+struct tbb_policy {};
+inline constexpr tbb_policy tbb_parallel;
+
+// tag to select the hand-written two-pass implementation of the kernels
+struct blocked_policy {};
+inline constexpr blocked_policy blocked_parallel;
+
+namespace scan_detail {
+
+  // elements per block of the two-pass scan; the block sums are few enough to be scanned serially
+  constexpr std::size_t block_size = 1 << 16;
+
+  // sum of in[begin, end)
+  template <typename T>
+  T sum(std::span<T const> in, std::size_t begin, std::size_t end) {
+    return lane_sum<T>(begin, end, [&](std::size_t i) { return in[i]; });
+  }
+
+  // number of elements of in[begin, end) that satisfy the predicate
+  template <typename T>
+  std::size_t count(std::span<T const> in, std::size_t begin, std::size_t end, auto predicate) {
+    std::size_t count = 0;
+    for (std::size_t i = begin; i < end; ++i) {
+      count += predicate(in[i]) ? 1 : 0;
+    }
+    return count;
+  }
+
+  // serial scan of in[begin, end) into out, starting from carry; return the sum including the last element
+  template <bool inclusive, typename T>
+  T serial_scan(std::span<T const> in, std::span<T> out, std::size_t begin, std::size_t end, T carry) {
+    for (std::size_t i = begin; i < end; ++i) {
+      T value = in[i];
+      if constexpr (inclusive) {
+        carry += value;
+        out[i] = carry;
+      } else {
+        out[i] = carry;
+        carry += value;
+      }
+    }
+    return carry;
+  }
+
+  // scan of in[begin, end) into out, starting from carry, eight 32-bit elements at a time: the prefix sum of each
+  // group of eight is computed in a 256-bit vector with three shifts and additions, and the carry is broadcast to all
+  // the lanes; other types fall back to the serial scan
+  template <bool inclusive, typename T>
+  T vector_scan(std::span<T const> in, std::span<T> out, std::size_t begin, std::size_t end, T carry) {
+    if constexpr (std::is_arithmetic_v<T> and sizeof(T) == 4) {
+      typedef T vector __attribute__((vector_size(32)));
+      constexpr std::size_t width = sizeof(vector) / sizeof(T);
+      const vector zero = {};
+      vector c = zero + carry;
+      std::size_t i = begin;
+      for (; i + width <= end; i += width) {
+        vector v;
+        std::memcpy(&v, in.data() + i, sizeof(vector));
+        // shift in zeros by 1, 2 and 4 lanes, and add
+        v += __builtin_shufflevector(zero, v, 0, 8, 9, 10, 11, 12, 13, 14);
+        v += __builtin_shufflevector(zero, v, 0, 1, 8, 9, 10, 11, 12, 13);
+        v += __builtin_shufflevector(zero, v, 0, 1, 2, 3, 8, 9, 10, 11);
+        vector result = inclusive ? v + c : __builtin_shufflevector(zero, v, 0, 8, 9, 10, 11, 12, 13, 14) + c;
+        std::memcpy(out.data() + i, &result, sizeof(vector));
+        v += c;
+        c = __builtin_shufflevector(v, v, 7, 7, 7, 7, 7, 7, 7, 7);
+      }
+      return serial_scan<inclusive>(in, out, i, end, c[0]);
+    } else {
+      return serial_scan<inclusive>(in, out, begin, end, carry);
+    }
+  }
+
+  // copy the elements of in[begin, end) that satisfy the predicate to out, starting from position, and return the
+  // position after the last one; the selected elements are first gathered without branches in a small buffer, because
+  // a branch on the predicate of random data would be mispredicted half of the times, then copied to out
+  template <typename T>
+  std::size_t copy_selected(std::span<T const> in,
+                            std::span<T> out,
+                            std::size_t begin,
+                            std::size_t end,
+                            std::size_t position,
+                            auto predicate) {
+    constexpr std::size_t buffer_size = 1024;
+    T buffer[buffer_size];
+    for (std::size_t i = begin; i < end; i += buffer_size) {
+      const std::size_t last = std::min(end, i + buffer_size);
+      std::size_t selected = 0;
+      for (std::size_t j = i; j < last; ++j) {
+        buffer[selected] = in[j];
+        selected += predicate(in[j]) ? 1 : 0;
+      }
+      std::copy_n(buffer, selected, out.begin() + position);
+      position += selected;
+    }
+    return position;
+  }
+
+  inline std::size_t blocks(std::size_t size) { return (size + block_size - 1) / block_size; }
+
+  // two-pass scan over blocks
+  template <bool inclusive, typename T>
+  void blocked_scan(std::span<T const> in, std::span<T> out) {
+    const std::size_t size = in.size();
+    const std::size_t n = blocks(size);
+    std::vector<T> offsets(n);
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n), [&](tbb::blocked_range<std::size_t> const& range) {
+      for (std::size_t b = range.begin(); b < range.end(); ++b) {
+        offsets[b] = sum(in, b * block_size, std::min(size, (b + 1) * block_size));
+      }
+    });
+    std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), T{0});
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n), [&](tbb::blocked_range<std::size_t> const& range) {
+      for (std::size_t b = range.begin(); b < range.end(); ++b) {
+        vector_scan<inclusive>(in, out, b * block_size, std::min(size, (b + 1) * block_size), offsets[b]);
+      }
+    });
+  }
+
+  // scan with tbb::parallel_scan; the pre-scan passes only compute the sum of their range
+  template <bool inclusive, typename T>
+  void tbb_scan(std::span<T const> in, std::span<T> out) {
+    tbb::parallel_scan(
+        tbb::blocked_range<std::size_t>(0, in.size()),
+        T{0},
+        [&](tbb::blocked_range<std::size_t> const& range, T carry, bool is_final_scan) -> T {
+          if (is_final_scan) {
+            return serial_scan<inclusive>(in, out, range.begin(), range.end(), carry);
+          }
+          return carry + sum(in, range.begin(), range.end());
+        },
+        std::plus<T>());
+  }
+
+}  // namespace scan_detail
+
+// out[i] = in[0] + ... + in[i]
+template <typename T, typename Policy>
+  requires std::is_execution_policy_v<std::remove_cvref_t<Policy>>
+void inclusive_scan(Policy&& policy, std::span<T const> in, std::span<T> out) {
+  std::inclusive_scan(policy, in.begin(), in.end(), out.begin());
+}
+
+template <typename T>
+void inclusive_scan(tbb_policy, std::span<T const> in, std::span<T> out) {
+  scan_detail::tbb_scan<true>(in, out);
+}
+
+template <typename T>
+void inclusive_scan(blocked_policy, std::span<T const> in, std::span<T> out) {
+  scan_detail::blocked_scan<true>(in, out);
+}
+
+// out[i] = in[0] + ... + in[i - 1], and out[0] = 0
+template <typename T, typename Policy>
+  requires std::is_execution_policy_v<std::remove_cvref_t<Policy>>
+void exclusive_scan(Policy&& policy, std::span<T const> in, std::span<T> out) {
+  std::exclusive_scan(policy, in.begin(), in.end(), out.begin(), T{0});
+}
+
+template <typename T>
+void exclusive_scan(tbb_policy, std::span<T const> in, std::span<T> out) {
+  scan_detail::tbb_scan<false>(in, out);
+}
+
+template <typename T>
+void exclusive_scan(blocked_policy, std::span<T const> in, std::span<T> out) {
+  scan_detail::blocked_scan<false>(in, out);
+}
+
+// Stream compaction: copy the elements of in that satisfy the predicate to the beginning of out, preserving their
+// order, and return their number. The position of each selected element is the exclusive scan of the predicate.
+
+// the parallel std::copy_if computes the same scan of the predicate internally
+template <typename T, typename Policy>
+  requires std::is_execution_policy_v<std::remove_cvref_t<Policy>>
+std::size_t compact(Policy&& policy, std::span<T const> in, std::span<T> out, auto predicate) {
+  return std::copy_if(policy, in.begin(), in.end(), out.begin(), predicate) - out.begin();
+}
+
+// the final pass of the scan writes each selected element at its position
+template <typename T>
+std::size_t compact(tbb_policy, std::span<T const> in, std::span<T> out, auto predicate) {
+  return tbb::parallel_scan(
+      tbb::blocked_range<std::size_t>(0, in.size()),
+      std::size_t{0},
+      [&](tbb::blocked_range<std::size_t> const& range, std::size_t position, bool is_final_scan) -> std::size_t {
+        if (not is_final_scan) {
+          return position + scan_detail::count(in, range.begin(), range.end(), predicate);
+        }
+        return scan_detail::copy_selected(in, out, range.begin(), range.end(), position, predicate);
+      },
+      std::plus<std::size_t>());
+}
+
+// the first pass counts the selected elements in each block, and the second pass copies them starting from the
+// position of the block
+template <typename T>
+std::size_t compact(blocked_policy, std::span<T const> in, std::span<T> out, auto predicate) {
+  using namespace scan_detail;
+  const std::size_t size = in.size();
+  const std::size_t n = blocks(size);
+  std::vector<std::size_t> positions(n + 1);
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n), [&](tbb::blocked_range<std::size_t> const& range) {
+    for (std::size_t b = range.begin(); b < range.end(); ++b) {
+      positions[b] = count(in, b * block_size, std::min(size, (b + 1) * block_size), predicate);
+    }
+  });
+  std::exclusive_scan(positions.begin(), positions.end(), positions.begin(), std::size_t{0});
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n), [&](tbb::blocked_range<std::size_t> const& range) {
+    for (std::size_t b = range.begin(); b < range.end(); ++b) {
+      copy_selected(in, out, b * block_size, std::min(size, (b + 1) * block_size), positions[b], predicate);
+    }
+  });
+  return positions[n];
+}
+
+#endif  // scan_h
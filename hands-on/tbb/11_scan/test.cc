@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <execution>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "measure.h"
+#include "philox.h"
+#include "scan.h"
+#include "thread_sweep.h"
+
+// Benchmark of the parallel prefix sums (scans) and of stream compaction.
+//
+// A scan reads and writes each element once, like a copy, but each output depends on all the previous inputs, so a
+// parallel scan needs to either read the input twice or make two passes over the output. The throughput of each kernel
+// is computed from the bytes it must read and write, and can be compared with the copy kernel of 09_stream_blas1.
+
+using Value = std::uint32_t;
+
+// the arrays used by the kernels
+struct Arrays {
+  Arrays(std::size_t size, std::uint64_t seed)
+      : size(size), in_(size), out_(std::make_unique_for_overwrite<Value[]>(size)), in(in_), out(out_.get(), size) {
+    philox::fill_bits(in_, seed);
+    // first touch the output in parallel
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, size), [&](tbb::blocked_range<std::size_t> const& range) {
+      std::fill(out.begin() + range.begin(), out.begin() + range.end(), Value{0});
+    });
+  }
+
+  std::size_t size;
+  std::vector<Value> in_;
+  std::unique_ptr<Value[]> out_;
+  std::span<Value const> in;
+  std::span<Value> out;
+};
+
+// a kernel of the benchmark
+struct Kernel {
+  std::string name;
+  // run the kernel, and return the number of elements written to the output
+  std::function<std::size_t()> run;
+  // the expected output
+  std::vector<Value> const& expected;
+};
+
+// run each kernel with the given implementation, check its results, and print its throughput; return false if any
+// of the results is wrong
+bool run_suite(std::string const& name,
+               std::vector<Kernel> const& kernels,
+               Arrays& arrays,
+               std::size_t times,
+               ThreadSweep& sweep) {
+  std::cout << name << '\n';
+  std::cout << "  kernel              best GB/s   avg ms   min ms   max ms\n";
+  for (auto const& kernel : kernels) {
+    // the first run warms up the thread pool, and its results are checked
+    std::size_t written = kernel.run();
+    if (written != kernel.expected.size() or
+        not std::equal(kernel.expected.begin(), kernel.expected.end(), arrays.out.begin())) {
+      std::cerr << kernel.name << ", " << name << ": wrong result\n";
+      return false;
+    }
+    std::vector<double> times_ms;
+    for (std::size_t i = 0; i < times; ++i) {
+      times_ms.push_back(measure(kernel.run));
+    }
+    double min = *std::ranges::min_element(times_ms);
+    double max = *std::ranges::max_element(times_ms);
+    double avg = std::accumulate(times_ms.begin(), times_ms.end(), 0.) / times;
+    // the input is read once, and each element of the output is written once
+    double gbs = static_cast<double>(arrays.size + written) * sizeof(Value) / (min * 1.e6);
+    std::cout << "  " << std::left << std::setw(18) << kernel.name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(11) << gbs << std::setw(9) << avg << std::setw(9) << min << std::setw(9) << max << '\n';
+    sweep.record(kernel.name + ", " + name, min);
+    emit("scan", times_ms, "size", arrays.size, "kernel", kernel.name, "implementation", name);
+  }
+  std::cout << '\n';
+  return true;
+}
+
+int main() {
+  // the arrays should be much larger than the last level cache
+  std::size_t size = 1 << 25;
+  const char* size_env = std::getenv("SCAN_SIZE");
+  if (size_env != nullptr and std::strlen(size_env) != 0) {
+    size = std::stoull(size_env);
+  }
+  std::size_t times = 10;
+  const char* times_env = std::getenv("SCAN_REPEATS");
+  if (times_env != nullptr and std::strlen(times_env) != 0) {
+    times = std::max(1, std::atoi(times_env));
+  }
+  // fraction of the elements kept by the compaction
+  double selectivity = 0.5;
+  const char* selectivity_env = std::getenv("SCAN_SELECTIVITY");
+  if (selectivity_env != nullptr and std::strlen(selectivity_env) != 0) {
+    selectivity = std::clamp(std::stod(selectivity_env), 0., 1.);
+  }
+
+  Arrays arrays(size, std::random_device{}());
+  std::cout << "array size: " << size << " elements, " << size * sizeof(Value) / 1048576 << " MB per array\n";
+  std::cout << "compaction selectivity: " << selectivity << "\n\n";
+
+  // the scans of random 32-bit values wrap around, and the unsigned arithmetic keeps the results exact in any order
+  const Value threshold = static_cast<Value>(selectivity * std::numeric_limits<Value>::max());
+  auto predicate = [threshold](Value x) { return x < threshold; };
+
+  // the expected results, computed serially
+  std::vector<Value> inclusive(size), exclusive(size), compacted;
+  std::inclusive_scan(arrays.in.begin(), arrays.in.end(), inclusive.begin());
+  std::exclusive_scan(arrays.in.begin(), arrays.in.end(), exclusive.begin(), Value{0});
+  std::copy_if(arrays.in.begin(), arrays.in.end(), std::back_inserter(compacted), predicate);
+
+  auto kernels = [&](auto policy) -> std::vector<Kernel> {
+    return {{"inclusive scan",
+             [&, policy] {
+               inclusive_scan(policy, arrays.in, arrays.out);
+               return size;
+             },
+             inclusive},
+            {"exclusive scan",
+             [&, policy] {
+               exclusive_scan(policy, arrays.in, arrays.out);
+               return size;
+             },
+             exclusive},
+            {"compaction", [&, policy] { return compact(policy, arrays.in, arrays.out, predicate); }, compacted}};
+  };
+
+  // optionally, repeat the measurements with 1, 2, 4, ... threads
+  ThreadSweep sweep;
+  bool ok = true;
+  sweep.run([&] {
+    ok = ok and run_suite("std::execution::seq", kernels(std::execution::seq), arrays, times, sweep);
+    ok = ok and run_suite("std::execution::unseq", kernels(std::execution::unseq), arrays, times, sweep);
+    ok = ok and run_suite("std::execution::par", kernels(std::execution::par), arrays, times, sweep);
+    ok = ok and run_suite("std::execution::par_unseq", kernels(std::execution::par_unseq), arrays, times, sweep);
+    ok = ok and run_suite("TBB parallel_scan", kernels(tbb_parallel), arrays, times, sweep);
+    ok = ok and run_suite("two-pass blocked scan", kernels(blocked_parallel), arrays, times, sweep);
+  });
+  if (not ok) {
+    return EXIT_FAILURE;
+  }
+  sweep.report(std::cout);
+}
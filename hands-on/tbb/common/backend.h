@@ -0,0 +1,230 @@
+#ifndef backend_h
+#define backend_h
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <execution>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <tbb/tbb.h>
+
+// Parallel backends selected at runtime.
+//
+// A kernel is written once as a function that processes a contiguous range of indices [begin, end), and each backend
+// splits the full range in chunks and runs them in parallel with a different runtime: the parallel algorithms of the
+// standard library, TBB, OpenMP, or a pool of std::threads. The body is called once per chunk rather than once per
+// element, so the inner loop over the chunk can still be vectorised.
+// The OpenMP backend is available only when compiling with -fopenmp.
+
+namespace backend {
+
+  using Body = std::function<void(std::size_t begin, std::size_t end)>;
+
+  class Backend {
+  public:
+    virtual ~Backend() = default;
+
+    virtual std::string name() const = 0;
+
+    // number of threads used by the backend
+    virtual int concurrency() const = 0;
+
+    // run body over [0, size), split in chunks of at least grain indices
+    virtual void parallel_for(std::size_t size, Body const& body, std::size_t grain = 1 << 14) = 0;
+
+  protected:
+    // split [0, size) in a few chunks per thread, to balance the load
+    std::size_t chunks(std::size_t size, std::size_t grain) const {
+      return std::clamp<std::size_t>(size / std::max<std::size_t>(grain, 1), 1, 4 * concurrency());
+    }
+
+    static void run_chunk(std::size_t size, std::size_t chunks, std::size_t chunk, Body const& body) {
+      std::size_t begin = size * chunk / chunks;
+      std::size_t end = size * (chunk + 1) / chunks;
+      if (begin < end) {
+        body(begin, end);
+      }
+    }
+  };
+
+  // parallel algorithms of the standard library, with the std::execution::par policy
+  class StdBackend : public Backend {
+  public:
+    std::string name() const override { return "std::execution"; }
+
+    int concurrency() const override { return tbb::this_task_arena::max_concurrency(); }
+
+    void parallel_for(std::size_t size, Body const& body, std::size_t grain = 1 << 14) override {
+      std::vector<std::size_t> indices(chunks(size, grain));
+      std::iota(indices.begin(), indices.end(), 0);
+      std::for_each(std::execution::par, indices.begin(), indices.end(), [&](std::size_t chunk) {
+        run_chunk(size, indices.size(), chunk, body);
+      });
+    }
+  };
+
+  class TbbBackend : public Backend {
+  public:
+    std::string name() const override { return "TBB"; }
+
+    int concurrency() const override { return tbb::this_task_arena::max_concurrency(); }
+
+    void parallel_for(std::size_t size, Body const& body, std::size_t grain = 1 << 14) override {
+      tbb::parallel_for(tbb::blocked_range<std::size_t>(0, size, std::max<std::size_t>(grain, 1)),
+                        [&](tbb::blocked_range<std::size_t> const& range) { body(range.begin(), range.end()); });
+    }
+  };
+
+#ifdef _OPENMP
+  class OpenMPBackend : public Backend {
+  public:
+    std::string name() const override { return "OpenMP"; }
+
+    int concurrency() const override { return omp_get_max_threads(); }
+
+    void parallel_for(std::size_t size, Body const& body, std::size_t grain = 1 << 14) override {
+      const std::size_t n = chunks(size, grain);
+#pragma omp parallel for schedule(dynamic)
+      for (std::size_t chunk = 0; chunk < n; ++chunk) {
+        run_chunk(size, n, chunk, body);
+      }
+    }
+  };
+#endif  // _OPENMP
+
+  // a pool of threads that is created once, and reused by all the calls; the chunks are distributed dynamically, and
+  // the calling thread takes part in the work
+  class ThreadPoolBackend : public Backend {
+  public:
+    explicit ThreadPoolBackend(int threads = std::thread::hardware_concurrency()) {
+      for (int i = 1; i < std::max(threads, 1); ++i) {
+        workers_.emplace_back([this] { work(); });
+      }
+    }
+
+    ~ThreadPoolBackend() override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      start_.notify_all();
+      for (auto& worker : workers_) {
+        worker.join();
+      }
+    }
+
+    std::string name() const override { return "std::thread pool"; }
+
+    int concurrency() const override { return workers_.size() + 1; }
+
+    void parallel_for(std::size_t size, Body const& body, std::size_t grain = 1 << 14) override {
+      std::unique_lock<std::mutex> lock(mutex_);
+      body_ = &body;
+      size_ = size;
+      chunks_ = chunks(size, grain);
+      next_ = 0;
+      active_ = workers_.size();
+      ++generation_;
+      lock.unlock();
+      start_.notify_all();
+
+      process();
+
+      // wait for the workers to finish their last chunk
+      lock.lock();
+      done_.wait(lock, [this] { return active_ == 0; });
+      body_ = nullptr;
+    }
+
+  private:
+    // process the chunks of the current call, until there are none left
+    void process() {
+      while (true) {
+        std::size_t chunk;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (next_ == chunks_) {
+            return;
+          }
+          chunk = next_++;
+        }
+        run_chunk(size_, chunks_, chunk, *body_);
+      }
+    }
+
+    void work() {
+      std::size_t generation = 0;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          start_.wait(lock, [&] { return stop_ or generation_ != generation; });
+          if (stop_) {
+            return;
+          }
+          generation = generation_;
+        }
+        process();
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          --active_;
+        }
+        done_.notify_one();
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    Body const* body_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t chunks_ = 0;
+    std::size_t next_ = 0;
+    std::size_t active_ = 0;
+    std::size_t generation_ = 0;
+    bool stop_ = false;
+  };
+
+  // names of the backends that can be created
+  inline std::vector<std::string> available() {
+    std::vector<std::string> names = {"std", "tbb"};
+#ifdef _OPENMP
+    names.push_back("openmp");
+#endif
+    names.push_back("threads");
+    return names;
+  }
+
+  // create a backend by name, or return a null pointer if it is not available in this build
+  inline std::unique_ptr<Backend> make_backend(std::string const& name) {
+    if (name == "std") {
+      return std::make_unique<StdBackend>();
+    }
+    if (name == "tbb") {
+      return std::make_unique<TbbBackend>();
+    }
+#ifdef _OPENMP
+    if (name == "openmp") {
+      return std::make_unique<OpenMPBackend>();
+    }
+#endif
+    if (name == "threads") {
+      return std::make_unique<ThreadPoolBackend>();
+    }
+    return nullptr;
+  }
+
+}  // namespace backend
+
+#endif  // backend_h
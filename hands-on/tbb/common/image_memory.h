@@ -0,0 +1,160 @@
+#ifndef image_memory_h
+#define image_memory_h
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+// Accounting of the memory used by the image data.
+//
+// The images report every allocation, release, copy and move of their pixel data. Each event is attributed to the
+// graph node whose body is running on the current thread, as declared by a MemoryStats::Scope at the beginning of the
+// body; the bytes allocated by a node remain attributed to it until they are released, even after the image has been
+// passed to another node. For each node this keeps track of the bytes alive at any time and of their peak, as well as
+// of the peak for the whole process.
+// When the accounting is disabled every hook costs a single relaxed load.
+class MemoryStats {
+public:
+  static constexpr int kMaxNodes = 32;
+  // events that happen outside of any node, e.g. in the main thread
+  static constexpr int kNoNode = 0;
+
+  // attribute the events on the current thread to the given node, until the scope is destroyed
+  class Scope {
+  public:
+    Scope(int node) : previous_(current_) { current_ = node; }
+    ~Scope() { current_ = previous_; }
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+  private:
+    int previous_;
+  };
+
+  MemoryStats() { names_[kNoNode] = "(other)"; }
+
+  void enable() { enabled_.store(true, std::memory_order_relaxed); }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // register a node type, and return its identifier; nodes with the same name share the same counters
+  int node(std::string const& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < size_; ++i) {
+      if (names_[i] == name) {
+        return i;
+      }
+    }
+    if (size_ == kMaxNodes) {
+      return kNoNode;
+    }
+    names_[size_] = name;
+    return size_++;
+  }
+
+  // account a new buffer of the given size, and return the node that owns it
+  int allocate(std::uint64_t bytes) {
+    if (not enabled()) {
+      return kNoNode;
+    }
+    Counters& c = counters_[current_];
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.allocated.fetch_add(bytes, std::memory_order_relaxed);
+    update_peak(c.peak, c.live.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    update_peak(peak_, live_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    return current_;
+  }
+
+  // account the release of a buffer owned by the given node
+  void release(int owner, std::uint64_t bytes) {
+    if (not enabled()) {
+      return;
+    }
+    counters_[owner].live.fetch_sub(bytes, std::memory_order_relaxed);
+    live_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  // account a deep copy of a buffer; the allocation of the new buffer is accounted separately
+  void copy(std::uint64_t bytes) {
+    if (not enabled()) {
+      return;
+    }
+    Counters& c = counters_[current_];
+    c.copies.fetch_add(1, std::memory_order_relaxed);
+    c.copied.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // account a move, that transfers the ownership of a buffer without copying it
+  void move() {
+    if (not enabled()) {
+      return;
+    }
+    counters_[current_].moves.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void report(std::ostream& out) const {
+    if (not enabled()) {
+      return;
+    }
+    out << fmt::format("\nimage memory: peak {:.1f} MB, still alive {:.1f} MB\n", peak_ / 1048576., live_ / 1048576.);
+    out << fmt::format("{:<12} {:>8} {:>12} {:>12} {:>8} {:>12} {:>8}\n",
+                       "node",
+                       "allocs",
+                       "alloc MB",
+                       "peak MB",
+                       "copies",
+                       "copied MB",
+                       "moves");
+    for (int i = 0; i < size_; ++i) {
+      Counters const& c = counters_[i];
+      if (c.allocations == 0 and c.copies == 0 and c.moves == 0) {
+        continue;
+      }
+      out << fmt::format("{:<12} {:>8} {:>12.1f} {:>12.1f} {:>8} {:>12.1f} {:>8}\n",
+                         names_[i],
+                         c.allocations.load(),
+                         c.allocated / 1048576.,
+                         c.peak / 1048576.,
+                         c.copies.load(),
+                         c.copied / 1048576.,
+                         c.moves.load());
+    }
+  }
+
+private:
+  struct Counters {
+    std::atomic<std::uint64_t> allocations = 0;
+    std::atomic<std::uint64_t> allocated = 0;
+    std::atomic<std::uint64_t> live = 0;
+    std::atomic<std::uint64_t> peak = 0;
+    std::atomic<std::uint64_t> copies = 0;
+    std::atomic<std::uint64_t> copied = 0;
+    std::atomic<std::uint64_t> moves = 0;
+  };
+
+  static void update_peak(std::atomic<std::uint64_t>& peak, std::uint64_t value) {
+    std::uint64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current and not peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  static inline thread_local int current_ = kNoNode;
+
+  std::atomic<bool> enabled_ = false;
+  std::mutex mutex_;
+  int size_ = 1;
+  std::array<std::string, kMaxNodes> names_;
+  std::array<Counters, kMaxNodes> counters_;
+  std::atomic<std::uint64_t> live_ = 0;
+  std::atomic<std::uint64_t> peak_ = 0;
+};
+
+#endif  // image_memory_h
@@ -0,0 +1,33 @@
+#ifndef lane_sum_h
+#define lane_sum_h
+
+#include <cstddef>
+
+// Sum of term(i) for i in [begin, end), accumulated in independent partial sums.
+//
+// With a single accumulator each addition waits for the result of the previous one. With one partial sum per lane the
+// additions of different lanes do not depend on each other, so they can be pipelined and mapped to the lanes of the
+// vector registers. The compiler could reorder the integer additions by itself, as they are associative, but not the
+// floating point ones: for those the explicit lanes are the only way to vectorise the loop without -ffast-math, and
+// they change the rounding of the result.
+template <typename T>
+T lane_sum(std::size_t begin, std::size_t end, auto term) {
+  constexpr std::size_t lanes = 16;
+  T partial[lanes] = {};
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    for (std::size_t j = 0; j < lanes; ++j) {
+      partial[j] += term(i + j);
+    }
+  }
+  for (; i < end; ++i) {
+    partial[0] += term(i);
+  }
+  T sum = 0;
+  for (std::size_t j = 0; j < lanes; ++j) {
+    sum += partial[j];
+  }
+  return sum;
+}
+
+#endif  // lane_sum_h
@@ -0,0 +1,63 @@
+#ifndef measure_h
+#define measure_h
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+#include "bench_report.h"
+
+// Helpers shared by the benchmarks that time a kernel several times.
+
+// Time a function in milliseconds.
+double measure(auto function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  auto finish = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+// Run a measurement on a newly allocated, uninitialised buffer every time, so the page faults of the first touch are
+// included in the time of the kernel. A buffer reused by all the measurements should instead be first touched with the
+// same partitioning as the kernel: each page is mapped on the NUMA node of the thread that touches it first, which is
+// then also the thread that writes to it in the kernel.
+template <typename T>
+std::vector<double> measure_cold(std::size_t size, std::size_t times, auto measure) {
+  std::vector<double> results;
+  for (std::size_t i = 0; i < times; ++i) {
+    auto buffer = std::make_unique_for_overwrite<T[]>(size);
+    results.push_back(measure(std::span<T>(buffer.get(), size)));
+  }
+  return results;
+}
+
+// Format the parameters of a benchmark, given as alternating keys and values, as the "key=value,key=value" list used by
+// bench_emit.
+template <typename... Parameters>
+std::string parameter_list(Parameters const&... parameters) {
+  static_assert(sizeof...(Parameters) % 2 == 0, "the parameters must be pairs of keys and values");
+  std::ostringstream list;
+  int index = 0;
+  ((list << (index == 0 ? "" : index % 2 == 0 ? "," : "=") << parameters, ++index), ...);
+  return list.str();
+}
+
+// Append the statistics of the times of a kernel, in ms, to the file given by BENCH_OUTPUT, if any, e.g.
+// emit("axpy", times, "size", size, "pages", "cold"); the number of threads is the current limit of the TBB
+// parallelism.
+template <typename... Parameters>
+void emit(const char* benchmark, std::vector<double> const& times, Parameters const&... parameters) {
+  bench_emit(benchmark,
+             parameter_list(parameters...).c_str(),
+             "ms",
+             bench_statistics(times.data(), times.size()),
+             tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism));
+}
+
+#endif  // measure_h
@@ -0,0 +1,106 @@
+#ifndef philox_h
+#define philox_h
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// Counter-based random number generation, to fill large inputs in parallel.
+//
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11) is a keyed bijection of a
+// 128-bit counter: encrypting the counters 0, 1, 2, ... with a key derived from the seed gives a stream of random
+// numbers, and any element of the stream can be computed independently of the others. Each block of elements is
+// filled from its own counters, so the content of a vector depends only on the seed and on its size, and not on the
+// number of threads or on how the work is split among them.
+
+namespace philox {
+
+  using Block = std::array<std::uint32_t, 4>;
+
+  // encrypt a counter with the given key, with the 10 rounds of Philox4x32
+  inline Block philox4x32(std::uint64_t counter, std::uint64_t key) {
+    constexpr std::uint32_t M0 = 0xD2511F53;
+    constexpr std::uint32_t M1 = 0xCD9E8D57;
+    constexpr std::uint32_t W0 = 0x9E3779B9;
+    constexpr std::uint32_t W1 = 0xBB67AE85;
+
+    Block c = {static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32), 0, 0};
+    std::uint32_t k0 = static_cast<std::uint32_t>(key);
+    std::uint32_t k1 = static_cast<std::uint32_t>(key >> 32);
+    for (int round = 0; round < 10; ++round) {
+      const std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c[0];
+      const std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c[2];
+      c = {static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k0,
+           static_cast<std::uint32_t>(p1),
+           static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k1,
+           static_cast<std::uint32_t>(p0)};
+      k0 += W0;
+      k1 += W1;
+    }
+    return c;
+  }
+
+  // a 128-bit block gives four 32-bit or two 64-bit values
+  template <typename T>
+  constexpr std::size_t values_per_block = (sizeof(T) <= 4) ? 4 : 2;
+
+  template <typename T>
+  T convert(Block const& block, std::size_t i);
+
+  template <>
+  inline std::uint32_t convert(Block const& block, std::size_t i) {
+    return block[i];
+  }
+
+  template <>
+  inline std::uint64_t convert(Block const& block, std::size_t i) {
+    return static_cast<std::uint64_t>(block[2 * i + 1]) << 32 | block[2 * i];
+  }
+
+  // uniform in [0, 1), from the 24 most significant bits
+  template <>
+  inline float convert(Block const& block, std::size_t i) {
+    return (block[i] >> 8) * 0x1p-24f;
+  }
+
+  // uniform in [0, 1), from the 53 most significant bits
+  template <>
+  inline double convert(Block const& block, std::size_t i) {
+    return (convert<std::uint64_t>(block, i) >> 11) * 0x1p-53;
+  }
+
+  // fill v in parallel, with f applied to the random values
+  template <typename T>
+  void fill(std::vector<T>& v, std::uint64_t seed, auto f) {
+    constexpr std::size_t n = values_per_block<T>;
+    const std::size_t size = v.size();
+    const std::size_t blocks = (size + n - 1) / n;
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, blocks), [&](tbb::blocked_range<std::size_t> const& range) {
+      for (std::size_t b = range.begin(); b < range.end(); ++b) {
+        const Block block = philox4x32(b, seed);
+        for (std::size_t i = 0; i < n and b * n + i < size; ++i) {
+          v[b * n + i] = f(convert<T>(block, i));
+        }
+      }
+    });
+  }
+
+  // fill v in parallel with random integers, uniform over all their values
+  template <std::unsigned_integral T>
+  void fill_bits(std::vector<T>& v, std::uint64_t seed) {
+    fill(v, seed, [](T value) { return value; });
+  }
+
+  // fill v in parallel with random numbers, uniform in [min, max)
+  template <std::floating_point T>
+  void fill_uniform(std::vector<T>& v, T min, T max, std::uint64_t seed) {
+    fill(v, seed, [=](T value) { return min + (max - min) * value; });
+  }
+
+}  // namespace philox
+
+#endif  // philox_h
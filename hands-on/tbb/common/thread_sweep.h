@@ -0,0 +1,99 @@
+#ifndef thread_sweep_h
+#define thread_sweep_h
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <tbb/tbb.h>
+
+// Thread-count scaling sweeps for the benchmarks.
+//
+// When THREAD_SWEEP is set, the benchmark runs once for each number of threads 1, 2, 4, ... up to the number of cores,
+// or up to the value of THREAD_SWEEP if it is a number (e.g. THREAD_SWEEP=all or THREAD_SWEEP=16). The parallelism is
+// limited with tbb::global_control, that also applies to the parallel algorithms of the standard library, as they use
+// TBB as their backend. Each measurement records its time at the current number of threads, and at the end the speedup
+// and the parallel efficiency of each measurement with respect to a single thread are reported.
+// Without THREAD_SWEEP the benchmark runs once, with the default number of threads.
+
+class ThreadSweep {
+public:
+  ThreadSweep() {
+    const char* sweep_env = std::getenv("THREAD_SWEEP");
+    enabled_ = sweep_env != nullptr and std::strlen(sweep_env) != 0;
+    int max_threads = tbb::info::default_concurrency();
+    if (enabled_) {
+      if (std::atoi(sweep_env) > 0) {
+        max_threads = std::atoi(sweep_env);
+      }
+      for (int threads = 1; threads < max_threads; threads *= 2) {
+        threads_.push_back(threads);
+      }
+    }
+    threads_.push_back(max_threads);
+  }
+
+  bool enabled() const { return enabled_; }
+
+  // run the benchmark once for each number of threads
+  void run(auto benchmark) {
+    for (int threads : threads_) {
+      tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+      current_ = threads;
+      if (enabled_) {
+        std::cout << "running with " << threads << " threads\n\n";
+      }
+      benchmark();
+    }
+  }
+
+  // record the time of a measurement with the current number of threads
+  void record(std::string const& name, double ms) {
+    if (not enabled_) {
+      return;
+    }
+    auto [it, inserted] = times_.try_emplace(name);
+    if (inserted) {
+      order_.push_back(name);
+    }
+    it->second[current_] = ms;
+  }
+
+  void report(std::ostream& out) const {
+    if (not enabled_) {
+      return;
+    }
+    out << "scaling with the number of threads\n";
+    for (auto const& name : order_) {
+      auto const& times = times_.at(name);
+      auto single = times.find(1);
+      out << name << '\n';
+      out << "  threads   time (ms)   speedup   efficiency\n";
+      for (auto [threads, ms] : times) {
+        out << std::fixed << std::setprecision(3) << std::setw(9) << threads << std::setw(12) << ms;
+        if (single != times.end() and ms > 0.) {
+          double speedup = single->second / ms;
+          out << std::setprecision(2) << std::setw(10) << speedup << std::setprecision(0) << std::setw(12)
+              << 100. * speedup / threads << '%';
+        }
+        out << '\n';
+      }
+    }
+    out << '\n';
+  }
+
+private:
+  bool enabled_ = false;
+  int current_ = 0;
+  std::vector<int> threads_;
+  // times of each measurement, by number of threads, and the measurements in the order they were first recorded
+  std::map<std::string, std::map<int, double>> times_;
+  std::vector<std::string> order_;
+};
+
+#endif  // thread_sweep_h